@@ -0,0 +1,145 @@
+#include "daemon_socket.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const string TCP_PREFIX = "tcp:"s;
+const string UNIX_PREFIX = "unix:"s;
+
+sockaddr_un MakeUnixAddress(const string& path) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw invalid_argument("Socket path is too long: "s + path);
+    }
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path.data(), path.size());
+    return address;
+}
+
+// Хост и порт из "порт" или "хост:порт"
+pair<string, string> SplitHostPort(const string& address) {
+    const size_t colon = address.rfind(':');
+    if (colon == string::npos) {
+        return {""s, address};
+    }
+    return {address.substr(0, colon), address.substr(colon + 1)};
+}
+
+addrinfo* ResolveTcp(const string& address, bool is_passive) {
+    const auto [host, port] = SplitHostPort(address);
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = is_passive ? AI_PASSIVE : 0;
+    addrinfo* result = nullptr;
+    const int error = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result);
+    if (error != 0) {
+        throw runtime_error("Cannot resolve "s + address + ": "s + gai_strerror(error));
+    }
+    return result;
+}
+
+bool StartsWith(const string& text, const string& prefix) {
+    return text.compare(0, prefix.size(), prefix) == 0;
+}
+
+}  // namespace
+
+int ListenOn(const string& address, int backlog) {
+    if (StartsWith(address, UNIX_PREFIX)) {
+        const string path = address.substr(UNIX_PREFIX.size());
+        const sockaddr_un unix_address = MakeUnixAddress(path);
+        const int descriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (descriptor < 0) {
+            throw runtime_error("Cannot create socket"s);
+        }
+        // сокет от прошлого запуска; другой файл по этому пути не трогаем,
+        // и bind на нём завершится ошибкой
+        struct stat status;
+        if (lstat(path.c_str(), &status) == 0 && S_ISSOCK(status.st_mode)) {
+            unlink(path.c_str());
+        }
+        if (bind(descriptor, reinterpret_cast<const sockaddr*>(&unix_address), sizeof(unix_address)) != 0
+                || listen(descriptor, backlog) != 0) {
+            close(descriptor);
+            throw runtime_error("Cannot listen on "s + address);
+        }
+        return descriptor;
+    }
+    if (!StartsWith(address, TCP_PREFIX)) {
+        throw invalid_argument("Unknown address: "s + address);
+    }
+
+    addrinfo* const addresses = ResolveTcp(address.substr(TCP_PREFIX.size()), true);
+    for (const addrinfo* info = addresses; info != nullptr; info = info->ai_next) {
+        const int descriptor = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        if (descriptor < 0) {
+            continue;
+        }
+        const int enabled = 1;
+        setsockopt(descriptor, SOL_SOCKET, SO_REUSEADDR, &enabled, sizeof(enabled));
+        if (bind(descriptor, info->ai_addr, info->ai_addrlen) == 0 && listen(descriptor, backlog) == 0) {
+            freeaddrinfo(addresses);
+            return descriptor;
+        }
+        close(descriptor);
+    }
+    freeaddrinfo(addresses);
+    throw runtime_error("Cannot listen on "s + address);
+}
+
+int ConnectTo(const string& address) {
+    if (StartsWith(address, UNIX_PREFIX)) {
+        const sockaddr_un unix_address = MakeUnixAddress(address.substr(UNIX_PREFIX.size()));
+        const int descriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (descriptor < 0) {
+            throw runtime_error("Cannot create socket"s);
+        }
+        if (connect(descriptor, reinterpret_cast<const sockaddr*>(&unix_address), sizeof(unix_address)) != 0) {
+            close(descriptor);
+            throw runtime_error("Cannot connect to "s + address);
+        }
+        return descriptor;
+    }
+    if (!StartsWith(address, TCP_PREFIX)) {
+        throw invalid_argument("Unknown address: "s + address);
+    }
+
+    addrinfo* const addresses = ResolveTcp(address.substr(TCP_PREFIX.size()), false);
+    for (const addrinfo* info = addresses; info != nullptr; info = info->ai_next) {
+        const int descriptor = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        if (descriptor < 0) {
+            continue;
+        }
+        if (connect(descriptor, info->ai_addr, info->ai_addrlen) == 0) {
+            // короткие запросы конвейером: без задержки Нейгла
+            const int enabled = 1;
+            setsockopt(descriptor, IPPROTO_TCP, TCP_NODELAY, &enabled, sizeof(enabled));
+            freeaddrinfo(addresses);
+            return descriptor;
+        }
+        close(descriptor);
+    }
+    freeaddrinfo(addresses);
+    throw runtime_error("Cannot connect to "s + address);
+}
+
+void SetNonBlocking(int descriptor) {
+    const int flags = fcntl(descriptor, F_GETFL, 0);
+    if (flags < 0 || fcntl(descriptor, F_SETFL, flags | O_NONBLOCK) != 0) {
+        throw runtime_error("Cannot make socket non-blocking"s);
+    }
+}
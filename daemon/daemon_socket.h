@@ -0,0 +1,9 @@
+#pragma once
+
+#include <string>
+
+// Адрес сокета: "tcp:порт", "tcp:хост:порт" или "unix:путь"
+int ListenOn(const std::string& address, int backlog);
+// Блокирующее соединение с сервером
+int ConnectTo(const std::string& address);
+void SetNonBlocking(int descriptor);
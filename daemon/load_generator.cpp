@@ -0,0 +1,264 @@
+// Нагрузка на search_server_daemon с той же машины: несколько соединений,
+// в каждом до pipeline запросов FIND без ответа. По окончании печатает
+// пропускную способность, число отказов BUSY и перцентили задержки.
+
+#include "daemon_socket.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+struct LoadOptions {
+    string address = "tcp:127.0.0.1:7878"s;
+    // запросы по одному на строку; без файла - случайные слова
+    string queries_path;
+    size_t connection_count = 8;
+    size_t pipeline = 16;
+    size_t top_k = 5;
+    int duration_seconds = 10;
+};
+
+struct LoadStats {
+    uint64_t ok_count = 0;
+    uint64_t busy_count = 0;
+    uint64_t error_count = 0;
+    vector<uint32_t> latencies_us;
+
+    void Merge(const LoadStats& other) {
+        ok_count += other.ok_count;
+        busy_count += other.busy_count;
+        error_count += other.error_count;
+        latencies_us.insert(latencies_us.end(), other.latencies_us.begin(), other.latencies_us.end());
+    }
+};
+
+vector<string> GenerateQueries(size_t query_count) {
+    mt19937 generator(42);
+    vector<string> words;
+    for (int i = 0; i < 1000; ++i) {
+        string word;
+        const int length = uniform_int_distribution(1, 10)(generator);
+        for (int j = 0; j < length; ++j) {
+            word.push_back(uniform_int_distribution('a', 'z')(generator));
+        }
+        words.push_back(move(word));
+    }
+    vector<string> queries;
+    for (size_t i = 0; i < query_count; ++i) {
+        string query;
+        for (int j = 0; j < 3; ++j) {
+            query += (j > 0 ? " "s : ""s) + words[uniform_int_distribution<size_t>(0, words.size() - 1)(generator)];
+        }
+        queries.push_back(move(query));
+    }
+    return queries;
+}
+
+vector<string> ReadQueries(const string& path) {
+    ifstream input(path);
+    if (!input) {
+        throw runtime_error("Cannot open "s + path);
+    }
+    vector<string> queries;
+    string line;
+    while (getline(input, line)) {
+        if (!line.empty()) {
+            queries.push_back(move(line));
+        }
+    }
+    if (queries.empty()) {
+        throw runtime_error("No queries in "s + path);
+    }
+    return queries;
+}
+
+void SendAll(int descriptor, const string& data) {
+    size_t offset = 0;
+    while (offset < data.size()) {
+        const ssize_t size = send(descriptor, data.data() + offset, data.size() - offset, MSG_NOSIGNAL);
+        if (size < 0) {
+            throw runtime_error("Connection lost"s);
+        }
+        offset += size;
+    }
+}
+
+// Одно соединение: держит pipeline запросов в полёте до deadline, затем дожидается ответов
+LoadStats RunConnection(const LoadOptions& options, const vector<string>& queries, size_t first_query,
+                        chrono::steady_clock::time_point deadline) {
+    const int descriptor = ConnectTo(options.address);
+    LoadStats stats;
+    deque<chrono::steady_clock::time_point> sent_times;
+    size_t query_index = first_query;
+    const string prefix = "FIND "s + to_string(options.top_k) + " "s;
+
+    const auto send_requests = [&](size_t count) {
+        string batch;
+        for (size_t i = 0; i < count; ++i) {
+            batch += prefix;
+            batch += queries[query_index++ % queries.size()];
+            batch += '\n';
+            sent_times.push_back(chrono::steady_clock::now());
+        }
+        SendAll(descriptor, batch);
+    };
+
+    send_requests(options.pipeline);
+    string input;
+    char buffer[1 << 14];
+    while (!sent_times.empty()) {
+        const ssize_t size = recv(descriptor, buffer, sizeof(buffer), 0);
+        if (size <= 0) {
+            close(descriptor);
+            throw runtime_error("Connection lost"s);
+        }
+        input.append(buffer, size);
+
+        size_t line_begin = 0;
+        size_t answered = 0;
+        const auto now = chrono::steady_clock::now();
+        for (size_t line_end; (line_end = input.find('\n', line_begin)) != string::npos; line_begin = line_end + 1) {
+            const string_view line(input.data() + line_begin, line_end - line_begin);
+            if (line.substr(0, 3) == "OK "sv) {
+                ++stats.ok_count;
+            } else if (line.substr(0, 8) == "ERR BUSY"sv) {
+                ++stats.busy_count;
+            } else {
+                ++stats.error_count;
+            }
+            const auto latency = chrono::duration_cast<chrono::microseconds>(now - sent_times.front());
+            stats.latencies_us.push_back(static_cast<uint32_t>(latency.count()));
+            sent_times.pop_front();
+            ++answered;
+        }
+        input.erase(0, line_begin);
+        if (answered > 0 && now < deadline) {
+            send_requests(answered);
+        }
+    }
+    close(descriptor);
+    return stats;
+}
+
+uint32_t GetPercentile(const vector<uint32_t>& sorted_values, double percentile) {
+    if (sorted_values.empty()) {
+        return 0;
+    }
+    const size_t index = static_cast<size_t>(percentile / 100.0 * (sorted_values.size() - 1));
+    return sorted_values[index];
+}
+
+size_t ParseCount(const string& value) {
+    size_t count;
+    const auto [end, error] = from_chars(value.data(), value.data() + value.size(), count);
+    if (error != errc() || end != value.data() + value.size()) {
+        throw invalid_argument("Invalid number: "s + value);
+    }
+    return count;
+}
+
+LoadOptions ParseOptions(int argc, char** argv) {
+    LoadOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const string_view name = argv[i];
+        if (i + 1 == argc) {
+            throw invalid_argument("Missing value for "s + string(name));
+        }
+        const string value = argv[++i];
+        if (name == "--address"sv) {
+            options.address = value;
+        } else if (name == "--queries"sv) {
+            options.queries_path = value;
+        } else if (name == "--connections"sv) {
+            options.connection_count = ParseCount(value);
+        } else if (name == "--pipeline"sv) {
+            options.pipeline = ParseCount(value);
+        } else if (name == "--top-k"sv) {
+            options.top_k = ParseCount(value);
+        } else if (name == "--duration"sv) {
+            options.duration_seconds = static_cast<int>(ParseCount(value));
+        } else {
+            throw invalid_argument("Unknown option "s + string(name));
+        }
+    }
+    if (options.connection_count == 0 || options.pipeline == 0) {
+        throw invalid_argument("Connections and pipeline must be positive"s);
+    }
+    return options;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    LoadOptions options;
+    try {
+        options = ParseOptions(argc, argv);
+    } catch (const exception& error) {
+        cerr << error.what() << "\n"
+                "Usage: " << argv[0] << " [--address tcp:HOST:PORT|unix:PATH] [--queries PATH]"
+                " [--connections N] [--pipeline N] [--top-k N] [--duration SECONDS]" << endl;
+        return 2;
+    }
+
+    try {
+        const vector<string> queries = options.queries_path.empty() ? GenerateQueries(10000)
+                                                                    : ReadQueries(options.queries_path);
+        const auto start = chrono::steady_clock::now();
+        const auto deadline = start + chrono::seconds(options.duration_seconds);
+
+        LoadStats total;
+        mutex total_mutex;
+        atomic<int> failed_count = 0;
+        vector<thread> connections;
+        for (size_t i = 0; i < options.connection_count; ++i) {
+            connections.emplace_back([&, i] {
+                try {
+                    const LoadStats stats = RunConnection(options, queries, i * queries.size() / options.connection_count,
+                                                          deadline);
+                    lock_guard lock(total_mutex);
+                    total.Merge(stats);
+                } catch (const exception& error) {
+                    cerr << error.what() << endl;
+                    ++failed_count;
+                }
+            });
+        }
+        for (thread& connection : connections) {
+            connection.join();
+        }
+        const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        sort(total.latencies_us.begin(), total.latencies_us.end());
+        const uint64_t response_count = total.ok_count + total.busy_count + total.error_count;
+        cout << "responses " << response_count << " in " << seconds << " s, "
+             << static_cast<uint64_t>(response_count / seconds) << " per second\n"
+             << "ok " << total.ok_count << ", busy " << total.busy_count << ", errors " << total.error_count
+             << ", failed connections " << failed_count << "\n"
+             << "latency us: p50 " << GetPercentile(total.latencies_us, 50)
+             << ", p90 " << GetPercentile(total.latencies_us, 90)
+             << ", p99 " << GetPercentile(total.latencies_us, 99)
+             << ", max " << (total.latencies_us.empty() ? 0 : total.latencies_us.back()) << endl;
+        return failed_count > 0 ? 1 : 0;
+    } catch (const exception& error) {
+        cerr << error.what() << endl;
+        return 1;
+    }
+}
@@ -0,0 +1,696 @@
+// Сетевой сервис поиска.
+//
+// Протокол строковый, по запросу на строку; запросы можно слать конвейером,
+// ответы приходят по одной строке в порядке запросов:
+//   FIND <top_k> <запрос>         -> OK <n> <id> <relevance> <rating> ...;
+//                                    top_k не больше 1000
+//   ADD <id> <статус> <рейтинги> <текст>
+//                                 -> OK; статус ACTUAL, IRRELEVANT, BANNED или
+//                                    REMOVED, рейтинги через запятую или "-"
+//   REMOVE <id>                   -> OK
+//   COUNT                         -> OK <число документов>
+// Ошибка запроса - "ERR <сообщение>". Если очередь запросов заполнена,
+// запрос сразу получает "ERR BUSY ..." и не выполняется.
+//
+// Один поток ведёт все соединения через epoll и не блокируется, запросы
+// выполняет фиксированный пул потоков. Поиск идёт по сегментированному
+// индексу, так что добавление и удаление не останавливают запросы.
+
+#include "daemon_socket.h"
+#include "../segmented_search_server.h"
+
+#include <algorithm>
+#include <charconv>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <csignal>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+struct DaemonOptions {
+    string address = "tcp:7878"s;
+    string stop_words;
+    // документы при запуске: строки "<id> <текст>"
+    string documents_path;
+    size_t worker_count = max(1u, thread::hardware_concurrency());
+    // запросов, принятых и ещё не выполненных, на весь сервер
+    size_t queue_capacity = 1024;
+    // запросов без отправленного ответа на одно соединение; дальше
+    // соединение не читается, пока клиент не заберёт ответы
+    size_t max_pipeline = 128;
+};
+
+const size_t MAX_LINE_SIZE = 1 << 16;
+// под top_k документов поиск резервирует память заранее
+const size_t MAX_TOP_K = 1000;
+const string BUSY_RESPONSE = "ERR BUSY too many requests in flight, retry later"s;
+
+struct Task {
+    uint64_t connection_id;
+    uint64_t sequence;
+    string request;
+};
+
+// Очередь задач ограниченного размера: добавление не ждёт, а отказывает
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity)
+        : capacity_(capacity) {
+    }
+
+    bool TryPush(Task&& task) {
+        {
+            lock_guard lock(mutex_);
+            if (tasks_.size() >= capacity_) {
+                return false;
+            }
+            tasks_.push_back(move(task));
+        }
+        not_empty_.notify_one();
+        return true;
+    }
+
+    // false, когда очередь закрыта и пуста
+    bool Pop(Task& task) {
+        unique_lock lock(mutex_);
+        not_empty_.wait(lock, [this] {
+            return !tasks_.empty() || is_closed_;
+        });
+        if (tasks_.empty()) {
+            return false;
+        }
+        task = move(tasks_.front());
+        tasks_.pop_front();
+        return true;
+    }
+
+    void Close() {
+        {
+            lock_guard lock(mutex_);
+            is_closed_ = true;
+        }
+        not_empty_.notify_all();
+    }
+
+private:
+    const size_t capacity_;
+    mutex mutex_;
+    condition_variable not_empty_;
+    deque<Task> tasks_;
+    bool is_closed_ = false;
+};
+
+struct Completion {
+    uint64_t connection_id;
+    uint64_t sequence;
+    string response;
+};
+
+// Готовые ответы от рабочих потоков; eventfd будит цикл событий
+class CompletionQueue {
+public:
+    CompletionQueue()
+        : event_descriptor_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+        if (event_descriptor_ < 0) {
+            throw runtime_error("Cannot create eventfd"s);
+        }
+    }
+    ~CompletionQueue() {
+        close(event_descriptor_);
+    }
+
+    int GetDescriptor() const {
+        return event_descriptor_;
+    }
+
+    void Push(Completion&& completion) {
+        bool was_empty;
+        {
+            lock_guard lock(mutex_);
+            was_empty = completions_.empty();
+            completions_.push_back(move(completion));
+        }
+        // цикл ещё не забрал прошлые ответы - значит, уже разбужен
+        if (was_empty) {
+            const uint64_t one = 1;
+            [[maybe_unused]] const ssize_t written = write(event_descriptor_, &one, sizeof(one));
+        }
+    }
+
+    vector<Completion> TakeAll() {
+        uint64_t counter;
+        [[maybe_unused]] const ssize_t read_size = read(event_descriptor_, &counter, sizeof(counter));
+        vector<Completion> completions;
+        lock_guard lock(mutex_);
+        completions.swap(completions_);
+        return completions;
+    }
+
+private:
+    const int event_descriptor_;
+    mutex mutex_;
+    vector<Completion> completions_;
+};
+
+// Следующее слово text; text сдвигается за него
+string_view NextToken(string_view& text) {
+    const size_t begin = min(text.find_first_not_of(' '), text.size());
+    text.remove_prefix(begin);
+    const size_t end = min(text.find(' '), text.size());
+    const string_view token = text.substr(0, end);
+    text.remove_prefix(end);
+    return token;
+}
+
+template <typename Number>
+Number ParseNumber(string_view token) {
+    Number value;
+    const auto [end, error] = from_chars(token.data(), token.data() + token.size(), value);
+    if (error != errc() || end != token.data() + token.size()) {
+        throw invalid_argument("Invalid number: "s + string(token));
+    }
+    return value;
+}
+
+DocumentStatus ParseStatus(string_view token) {
+    static const map<string_view, DocumentStatus> statuses = {
+        {"ACTUAL"sv, DocumentStatus::ACTUAL},
+        {"IRRELEVANT"sv, DocumentStatus::IRRELEVANT},
+        {"BANNED"sv, DocumentStatus::BANNED},
+        {"REMOVED"sv, DocumentStatus::REMOVED},
+    };
+    const auto it = statuses.find(token);
+    if (it == statuses.end()) {
+        throw invalid_argument("Invalid status: "s + string(token));
+    }
+    return it->second;
+}
+
+vector<int> ParseRatings(string_view token) {
+    vector<int> ratings;
+    if (token == "-"sv) {
+        return ratings;
+    }
+    while (!token.empty()) {
+        const size_t comma = min(token.find(','), token.size());
+        ratings.push_back(ParseNumber<int>(token.substr(0, comma)));
+        token.remove_prefix(min(comma + 1, token.size()));
+    }
+    return ratings;
+}
+
+string FormatDocuments(const vector<Document>& documents) {
+    string response = "OK "s + to_string(documents.size());
+    char buffer[64];
+    for (const Document& document : documents) {
+        const int size = snprintf(buffer, sizeof(buffer), " %d %.9g %d", document.id, document.relevance,
+                                  document.rating);
+        response.append(buffer, size);
+    }
+    return response;
+}
+
+string ExecuteRequest(SegmentedSearchServer& search_server, string_view request) {
+    try {
+        const string_view command = NextToken(request);
+        if (command == "FIND"sv) {
+            const size_t top_k = ParseNumber<size_t>(NextToken(request));
+            if (top_k > MAX_TOP_K) {
+                return "ERR top_k must not exceed "s + to_string(MAX_TOP_K);
+            }
+            return FormatDocuments(search_server.FindTopDocuments(request, DocumentStatus::ACTUAL, top_k));
+        }
+        if (command == "ADD"sv) {
+            const int document_id = ParseNumber<int>(NextToken(request));
+            const DocumentStatus status = ParseStatus(NextToken(request));
+            const vector<int> ratings = ParseRatings(NextToken(request));
+            search_server.AddDocument(document_id, request, status, ratings);
+            return "OK"s;
+        }
+        if (command == "REMOVE"sv) {
+            search_server.RemoveDocument(ParseNumber<int>(NextToken(request)));
+            return "OK"s;
+        }
+        if (command == "COUNT"sv) {
+            return "OK "s + to_string(search_server.GetDocumentCount());
+        }
+        return "ERR Unknown command: "s + string(command);
+    } catch (const exception& error) {
+        return "ERR "s + error.what();
+    }
+}
+
+struct Connection {
+    int descriptor = -1;
+    string input;
+    string output;
+    size_t output_offset = 0;
+    // номер следующего запроса и номер запроса, чей ответ отправляется следующим
+    uint64_t next_sequence = 0;
+    uint64_t next_to_send = 0;
+    // ответы, пришедшие раньше ответов на предыдущие запросы
+    map<uint64_t, string> ready;
+    // клиент закрыл передачу; соединение закрывается после всех ответов
+    bool is_input_closed = false;
+    // клиент закрыл соединение (EPOLLHUP); оно снято с наблюдения epoll
+    bool is_hung_up = false;
+    uint32_t events = 0;
+
+    uint64_t GetInFlightCount() const {
+        return next_sequence - next_to_send;
+    }
+};
+
+class Daemon {
+public:
+    Daemon(const DaemonOptions& options, SegmentedSearchServer& search_server, int signal_descriptor)
+        : options_(options)
+        , search_server_(search_server)
+        , tasks_(options.queue_capacity)
+        , signal_descriptor_(signal_descriptor) {
+    }
+
+    void Run();
+
+private:
+    // служебные метки событий epoll; соединения нумеруются после них
+    static const uint64_t LISTEN_TAG = 0;
+    static const uint64_t COMPLETION_TAG = 1;
+    static const uint64_t SIGNAL_TAG = 2;
+
+    const DaemonOptions& options_;
+    SegmentedSearchServer& search_server_;
+    BoundedQueue tasks_;
+    CompletionQueue completions_;
+    const int signal_descriptor_;
+    int epoll_descriptor_ = -1;
+    int listen_descriptor_ = -1;
+    uint64_t next_connection_id_ = SIGNAL_TAG + 1;
+    unordered_map<uint64_t, Connection> connections_;
+    uint64_t accepted_count_ = 0;
+    uint64_t rejected_count_ = 0;
+
+    void Watch(int descriptor, uint64_t tag);
+    void AcceptConnections();
+    void ReadInput(uint64_t connection_id, Connection& connection);
+    // Разбирает полные строки ввода, пока не заполнен конвейер соединения
+    void ProcessInput(uint64_t connection_id, Connection& connection);
+    void DeliverCompletions();
+    // Пишет готовые по порядку ответы; false, если соединение закрыто
+    bool Flush(uint64_t connection_id, Connection& connection);
+    void UpdateEvents(uint64_t connection_id, Connection& connection);
+    void CloseConnection(uint64_t connection_id);
+    void RunWorker();
+};
+
+void Daemon::Watch(int descriptor, uint64_t tag) {
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = tag;
+    if (epoll_ctl(epoll_descriptor_, EPOLL_CTL_ADD, descriptor, &event) != 0) {
+        throw runtime_error("Cannot watch descriptor"s);
+    }
+}
+
+void Daemon::Run() {
+    epoll_descriptor_ = epoll_create1(EPOLL_CLOEXEC);
+    listen_descriptor_ = ListenOn(options_.address, SOMAXCONN);
+    SetNonBlocking(listen_descriptor_);
+    Watch(listen_descriptor_, LISTEN_TAG);
+    Watch(completions_.GetDescriptor(), COMPLETION_TAG);
+    Watch(signal_descriptor_, SIGNAL_TAG);
+
+    vector<thread> workers;
+    for (size_t i = 0; i < options_.worker_count; ++i) {
+        workers.emplace_back([this] {
+            RunWorker();
+        });
+    }
+    cerr << "Listening on " << options_.address << ", " << options_.worker_count << " workers" << endl;
+
+    vector<epoll_event> events(256);
+    bool is_stopping = false;
+    while (!is_stopping) {
+        const int event_count = epoll_wait(epoll_descriptor_, events.data(), static_cast<int>(events.size()), -1);
+        if (event_count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw runtime_error("epoll_wait failed"s);
+        }
+        for (int i = 0; i < event_count; ++i) {
+            const uint64_t tag = events[i].data.u64;
+            if (tag == LISTEN_TAG) {
+                AcceptConnections();
+            } else if (tag == COMPLETION_TAG) {
+                DeliverCompletions();
+            } else if (tag == SIGNAL_TAG) {
+                is_stopping = true;
+            } else {
+                const auto it = connections_.find(tag);
+                // соединение могло закрыться на предыдущем событии этого же вызова
+                if (it == connections_.end()) {
+                    continue;
+                }
+                if (events[i].events & EPOLLERR) {
+                    CloseConnection(tag);
+                    continue;
+                }
+                // EPOLLHUP приходит при любой маске событий, поэтому соединение
+                // снимается с наблюдения: остаток ввода дочитывается сейчас, а
+                // ответы отправляются по мере готовности
+                if ((events[i].events & EPOLLHUP) && !it->second.is_hung_up) {
+                    it->second.is_hung_up = true;
+                    epoll_ctl(epoll_descriptor_, EPOLL_CTL_DEL, it->second.descriptor, nullptr);
+                }
+                if (events[i].events & (EPOLLIN | EPOLLHUP)) {
+                    ReadInput(tag, it->second);
+                } else if (events[i].events & EPOLLOUT) {
+                    Flush(tag, it->second);
+                }
+            }
+        }
+    }
+
+    tasks_.Close();
+    for (thread& worker : workers) {
+        worker.join();
+    }
+    while (!connections_.empty()) {
+        CloseConnection(connections_.begin()->first);
+    }
+    close(listen_descriptor_);
+    close(epoll_descriptor_);
+    cerr << "Accepted " << accepted_count_ << " requests, rejected " << rejected_count_ << endl;
+}
+
+void Daemon::AcceptConnections() {
+    while (true) {
+        const int descriptor = accept4(listen_descriptor_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (descriptor < 0) {
+            // EAGAIN - очередь подключений пуста; прочие ошибки касаются одного клиента
+            return;
+        }
+        const int enabled = 1;
+        setsockopt(descriptor, IPPROTO_TCP, TCP_NODELAY, &enabled, sizeof(enabled));
+        const uint64_t connection_id = next_connection_id_++;
+        Connection& connection = connections_[connection_id];
+        connection.descriptor = descriptor;
+        connection.events = EPOLLIN;
+        epoll_event event{};
+        event.events = connection.events;
+        event.data.u64 = connection_id;
+        if (epoll_ctl(epoll_descriptor_, EPOLL_CTL_ADD, descriptor, &event) != 0) {
+            CloseConnection(connection_id);
+        }
+    }
+}
+
+// Ввод читается, пока в буфере не больше строки наибольшей длины: остальное
+// ждёт в сокете, пока конвейер не освободится. После EPOLLHUP сокет
+// дочитывается до конца - новых событий по нему не будет
+void Daemon::ReadInput(uint64_t connection_id, Connection& connection) {
+    char buffer[1 << 14];
+    while (connection.input.size() <= MAX_LINE_SIZE || connection.is_hung_up) {
+        const ssize_t size = recv(connection.descriptor, buffer, sizeof(buffer), 0);
+        if (size > 0) {
+            connection.input.append(buffer, size);
+            if (static_cast<size_t>(size) < sizeof(buffer) && !connection.is_hung_up) {
+                break;
+            }
+            continue;
+        }
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size == 0 || connection.is_hung_up) {
+            connection.is_input_closed = true;
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            CloseConnection(connection_id);
+            return;
+        }
+        break;
+    }
+    ProcessInput(connection_id, connection);
+    Flush(connection_id, connection);
+}
+
+void Daemon::ProcessInput(uint64_t connection_id, Connection& connection) {
+    size_t line_begin = 0;
+    while (connection.GetInFlightCount() < options_.max_pipeline) {
+        const size_t line_end = connection.input.find('\n', line_begin);
+        if (line_end == string::npos) {
+            break;
+        }
+        string_view line(connection.input.data() + line_begin, line_end - line_begin);
+        line_begin = line_end + 1;
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (line.empty()) {
+            continue;
+        }
+        const uint64_t sequence = connection.next_sequence++;
+        if (tasks_.TryPush({connection_id, sequence, string(line)})) {
+            ++accepted_count_;
+        } else {
+            ++rejected_count_;
+            connection.ready.emplace(sequence, BUSY_RESPONSE);
+        }
+    }
+    connection.input.erase(0, line_begin);
+    // строка без конца не поместится ни в какой буфер: ответ и закрытие
+    if (connection.input.size() > MAX_LINE_SIZE && connection.input.find('\n') == string::npos) {
+        connection.ready.emplace(connection.next_sequence++, "ERR Request line is too long"s);
+        connection.input.clear();
+        connection.is_input_closed = true;
+    }
+}
+
+void Daemon::DeliverCompletions() {
+    // ответы одного соединения отправляются вместе
+    vector<uint64_t> connection_ids;
+    for (Completion& completion : completions_.TakeAll()) {
+        const auto it = connections_.find(completion.connection_id);
+        if (it == connections_.end()) {
+            continue;
+        }
+        it->second.ready.emplace(completion.sequence, move(completion.response));
+        connection_ids.push_back(completion.connection_id);
+    }
+    sort(connection_ids.begin(), connection_ids.end());
+    connection_ids.erase(unique(connection_ids.begin(), connection_ids.end()), connection_ids.end());
+    for (const uint64_t connection_id : connection_ids) {
+        Flush(connection_id, connections_.at(connection_id));
+    }
+}
+
+bool Daemon::Flush(uint64_t connection_id, Connection& connection) {
+    for (auto it = connection.ready.begin();
+         it != connection.ready.end() && it->first == connection.next_to_send;
+         it = connection.ready.erase(it)) {
+        connection.output += it->second;
+        connection.output += '\n';
+        ++connection.next_to_send;
+    }
+
+    while (connection.output_offset < connection.output.size()) {
+        const ssize_t size = send(connection.descriptor, connection.output.data() + connection.output_offset,
+                                  connection.output.size() - connection.output_offset, MSG_NOSIGNAL);
+        if (size < 0) {
+            // после EPOLLHUP готовность к записи уже не придёт
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && !connection.is_hung_up) {
+                break;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            CloseConnection(connection_id);
+            return false;
+        }
+        connection.output_offset += size;
+    }
+    if (connection.output_offset == connection.output.size()) {
+        connection.output.clear();
+        connection.output_offset = 0;
+    }
+
+    // отправленные ответы освободили место в конвейере
+    if (!connection.input.empty() && connection.GetInFlightCount() < options_.max_pipeline) {
+        const uint64_t next_sequence = connection.next_sequence;
+        ProcessInput(connection_id, connection);
+        // ответы на отклонённые запросы уже готовы
+        if (connection.next_sequence != next_sequence && !connection.ready.empty()
+                && connection.ready.begin()->first == connection.next_to_send) {
+            return Flush(connection_id, connection);
+        }
+    }
+    if (connection.is_input_closed && connection.GetInFlightCount() == 0 && connection.output.empty()) {
+        CloseConnection(connection_id);
+        return false;
+    }
+    UpdateEvents(connection_id, connection);
+    return true;
+}
+
+void Daemon::UpdateEvents(uint64_t connection_id, Connection& connection) {
+    if (connection.is_hung_up) {
+        return;
+    }
+    uint32_t events = 0;
+    if (!connection.is_input_closed && connection.GetInFlightCount() < options_.max_pipeline) {
+        events |= EPOLLIN;
+    }
+    if (!connection.output.empty()) {
+        events |= EPOLLOUT;
+    }
+    if (events == connection.events) {
+        return;
+    }
+    epoll_event event{};
+    event.events = events;
+    event.data.u64 = connection_id;
+    epoll_ctl(epoll_descriptor_, EPOLL_CTL_MOD, connection.descriptor, &event);
+    connection.events = events;
+}
+
+void Daemon::CloseConnection(uint64_t connection_id) {
+    const auto it = connections_.find(connection_id);
+    // ответы на запросы, ещё стоящие в очереди, будут выброшены в DeliverCompletions
+    if (!it->second.is_hung_up) {
+        epoll_ctl(epoll_descriptor_, EPOLL_CTL_DEL, it->second.descriptor, nullptr);
+    }
+    close(it->second.descriptor);
+    connections_.erase(it);
+}
+
+void Daemon::RunWorker() {
+    Task task;
+    while (tasks_.Pop(task)) {
+        completions_.Push({task.connection_id, task.sequence, ExecuteRequest(search_server_, task.request)});
+    }
+}
+
+void LoadDocuments(const string& path, SegmentedSearchServer& search_server) {
+    ifstream input(path);
+    if (!input) {
+        throw runtime_error("Cannot open "s + path);
+    }
+    string line;
+    int line_number = 0;
+    while (getline(input, line)) {
+        ++line_number;
+        string_view text = line;
+        const string_view id_token = NextToken(text);
+        if (id_token.empty()) {
+            continue;
+        }
+        try {
+            search_server.AddDocument(ParseNumber<int>(id_token), text, DocumentStatus::ACTUAL, {});
+        } catch (const exception& error) {
+            cerr << path << ":" << line_number << ": " << error.what() << endl;
+        }
+    }
+}
+
+void PrintUsage(const char* program) {
+    cerr << "Usage: " << program << " [options]\n"
+            "  --address ADDRESS   tcp:PORT, tcp:HOST:PORT or unix:PATH (default tcp:7878)\n"
+            "  --documents PATH    initial documents, one \"<id> <text>\" per line\n"
+            "  --stop-words WORDS  space separated stop words\n"
+            "  --workers N         worker threads (default: number of cores)\n"
+            "  --queue N           requests queued for workers before BUSY (default 1024)\n"
+            "  --pipeline N        unanswered requests per connection (default 128)\n";
+}
+
+DaemonOptions ParseOptions(int argc, char** argv) {
+    DaemonOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const string_view name = argv[i];
+        if (i + 1 == argc) {
+            throw invalid_argument("Missing value for "s + string(name));
+        }
+        const string value = argv[++i];
+        if (name == "--address"sv) {
+            options.address = value;
+        } else if (name == "--documents"sv) {
+            options.documents_path = value;
+        } else if (name == "--stop-words"sv) {
+            options.stop_words = value;
+        } else if (name == "--workers"sv) {
+            options.worker_count = ParseNumber<size_t>(value);
+        } else if (name == "--queue"sv) {
+            options.queue_capacity = ParseNumber<size_t>(value);
+        } else if (name == "--pipeline"sv) {
+            options.max_pipeline = ParseNumber<size_t>(value);
+        } else {
+            throw invalid_argument("Unknown option "s + string(name));
+        }
+    }
+    if (options.worker_count == 0 || options.queue_capacity == 0 || options.max_pipeline == 0) {
+        throw invalid_argument("Workers, queue and pipeline must be positive"s);
+    }
+    return options;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    DaemonOptions options;
+    try {
+        options = ParseOptions(argc, argv);
+    } catch (const exception& error) {
+        cerr << error.what() << endl;
+        PrintUsage(argv[0]);
+        return 2;
+    }
+
+    try {
+        // сигналы остановки читаются в цикле событий; маска наследуется рабочими потоками
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+        const int signal_descriptor = signalfd(-1, &signals, SFD_CLOEXEC);
+        if (signal_descriptor < 0) {
+            throw runtime_error("Cannot create signalfd"s);
+        }
+
+        SegmentedSearchServer search_server(options.stop_words);
+        if (!options.documents_path.empty()) {
+            LoadDocuments(options.documents_path, search_server);
+            search_server.WaitForMerges();
+            cerr << "Loaded " << search_server.GetDocumentCount() << " documents" << endl;
+        }
+        Daemon daemon(options, search_server, signal_descriptor);
+        daemon.Run();
+        close(signal_descriptor);
+    } catch (const exception& error) {
+        cerr << error.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include <iostream>
+#include <string_view>
 #include <vector>
 
 struct Document {
@@ -23,6 +24,14 @@ enum class DocumentStatus {
     REMOVED,
 };
 
+// Документ для пакетного добавления; текст должен жить до конца вызова
+struct DocumentInput {
+    int id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
 std::ostream& operator<<(std::ostream& out, const Document& document);
 
 void PrintDocument(const Document& document);
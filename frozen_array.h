@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+// Массив неизменяемого индекса: либо собственный вектор, заполняемый при
+// построении, либо участок чужой памяти (например, отображённого файла),
+// который должен жить дольше массива. Чтение одинаково в обоих случаях
+template <typename T>
+class FrozenArray {
+public:
+    FrozenArray() = default;
+    FrozenArray(std::initializer_list<T> values)
+        : values_(values) {
+        Refresh();
+    }
+
+    static FrozenArray View(const T* data, size_t size) {
+        FrozenArray array;
+        array.data_ = data;
+        array.size_ = size;
+        return array;
+    }
+
+    FrozenArray(FrozenArray&& other) noexcept {
+        *this = std::move(other);
+    }
+    FrozenArray& operator=(FrozenArray&& other) noexcept {
+        values_ = std::move(other.values_);
+        data_ = other.data_;
+        size_ = other.size_;
+        other.data_ = nullptr;
+        other.size_ = 0;
+        return *this;
+    }
+
+    // Изменение - только при построении собственного массива
+    void reserve(size_t capacity) {
+        values_.reserve(capacity);
+        Refresh();
+    }
+    void push_back(const T& value) {
+        values_.push_back(value);
+        Refresh();
+    }
+    void resize(size_t size) {
+        values_.resize(size);
+        Refresh();
+    }
+    void append(const T* data, size_t size) {
+        values_.insert(values_.end(), data, data + size);
+        Refresh();
+    }
+    void clear() {
+        values_.clear();
+        Refresh();
+    }
+    // Отдельные имена, чтобы чтение через неконстантную ссылку не попадало
+    // в собственный вектор, пустой у массива-представления
+    T& mutable_back() {
+        return values_.back();
+    }
+    T* mutable_data() {
+        return values_.data();
+    }
+
+    const T& operator[](size_t index) const {
+        return data_[index];
+    }
+    const T& back() const {
+        return data_[size_ - 1];
+    }
+    const T* data() const {
+        return data_;
+    }
+    const T* begin() const {
+        return data_;
+    }
+    const T* end() const {
+        return data_ + size_;
+    }
+    size_t size() const {
+        return size_;
+    }
+    bool empty() const {
+        return size_ == 0;
+    }
+
+private:
+    std::vector<T> values_;
+    const T* data_ = nullptr;
+    size_t size_ = 0;
+
+    void Refresh() {
+        data_ = values_.data();
+        size_ = values_.size();
+    }
+};
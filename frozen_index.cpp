@@ -0,0 +1,334 @@
+#include "frozen_index.h"
+#include "posting_codec.h"
+
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+FrozenIndex::FrozenIndex(PostingFormat format, const vector<int>& document_word_counts)
+    : format_(format) {
+    if (format_ == PostingFormat::COMPRESSED) {
+        inverse_document_lengths_.reserve(document_word_counts.size());
+        for (const int word_count : document_word_counts) {
+            inverse_document_lengths_.push_back(1.0 / word_count);
+        }
+    }
+}
+
+void FrozenIndex::Reserve(size_t word_count, size_t posting_count) {
+    const size_t block_count = posting_count / BLOCK_SIZE + word_count;
+    inverse_document_freqs_.reserve(word_count);
+    offsets_.reserve(word_count + 1);
+    max_term_freqs_.reserve(word_count);
+    block_offsets_.reserve(word_count + 1);
+    block_max_term_freqs_.reserve(block_count);
+    block_last_documents_.reserve(block_count);
+    if (format_ == PostingFormat::PLAIN) {
+        document_ids_.reserve(posting_count);
+        term_freqs_.reserve(posting_count);
+    } else {
+        block_data_offsets_.reserve(block_count);
+        // номер и число вхождений чаще всего укладываются в байт-два
+        data_.reserve(posting_count * 3 + STREAM_VBYTE_PADDING);
+    }
+}
+
+void FrozenIndex::Save(SnapshotWriter& writer) const {
+    writer.WriteValue(static_cast<uint32_t>(format_));
+    writer.WriteValue(static_cast<uint32_t>(impact_precision_));
+    writer.WriteValue(impact_scale_);
+    writer.WriteArray(inverse_document_lengths_);
+    writer.WriteArray(inverse_document_freqs_);
+    writer.WriteArray(offsets_);
+    writer.WriteArray(max_term_freqs_);
+    writer.WriteArray(block_offsets_);
+    writer.WriteArray(block_max_term_freqs_);
+    writer.WriteArray(block_last_documents_);
+    writer.WriteArray(document_ids_);
+    writer.WriteArray(term_freqs_);
+    writer.WriteArray(block_data_offsets_);
+    writer.WriteArray(data_);
+    writer.WriteArray(impacts_);
+}
+
+FrozenIndex FrozenIndex::Load(SnapshotReader& reader) {
+    FrozenIndex index;
+    const auto format = reader.ReadValue<uint32_t>();
+    const auto precision = reader.ReadValue<uint32_t>();
+    SnapshotReader::Check(format <= static_cast<uint32_t>(PostingFormat::COMPRESSED)
+                          && precision <= static_cast<uint32_t>(ImpactPrecision::BITS_8));
+    index.format_ = static_cast<PostingFormat>(format);
+    index.impact_precision_ = static_cast<ImpactPrecision>(precision);
+    index.impact_scale_ = reader.ReadValue<double>();
+    index.inverse_document_lengths_ = reader.ReadArray<double>();
+    index.inverse_document_freqs_ = reader.ReadArray<double>();
+    index.offsets_ = reader.ReadArray<size_t>();
+    index.max_term_freqs_ = reader.ReadArray<double>();
+    index.block_offsets_ = reader.ReadArray<size_t>();
+    index.block_max_term_freqs_ = reader.ReadArray<double>();
+    index.block_last_documents_ = reader.ReadArray<int>();
+    index.document_ids_ = reader.ReadArray<int>();
+    index.term_freqs_ = reader.ReadArray<double>();
+    index.block_data_offsets_ = reader.ReadArray<size_t>();
+    index.data_ = reader.ReadArray<uint8_t>();
+    index.impacts_ = reader.ReadArray<uint8_t>();
+
+    // размеры массивов согласованы между собой; содержимое защищено контрольной суммой
+    const FrozenIndex& loaded = index;
+    const size_t word_count = loaded.inverse_document_freqs_.size();
+    SnapshotReader::Check(loaded.offsets_.size() == word_count + 1 && loaded.block_offsets_.size() == word_count + 1
+                          && loaded.max_term_freqs_.size() == word_count);
+    const size_t posting_count = loaded.offsets_.back();
+    const size_t block_count = loaded.block_offsets_.back();
+    SnapshotReader::Check(loaded.block_max_term_freqs_.size() == block_count
+                          && loaded.block_last_documents_.size() == block_count);
+    if (loaded.format_ == PostingFormat::PLAIN) {
+        SnapshotReader::Check(loaded.document_ids_.size() == posting_count
+                              && loaded.term_freqs_.size() == posting_count);
+    } else {
+        SnapshotReader::Check(loaded.block_data_offsets_.size() == block_count
+                              && (block_count == 0 || loaded.data_.size() >= STREAM_VBYTE_PADDING));
+    }
+    const size_t impact_size = loaded.impact_precision_ == ImpactPrecision::EXACT ? 0
+            : loaded.impact_precision_ == ImpactPrecision::BITS_8 ? 1 : 2;
+    SnapshotReader::Check(loaded.impacts_.size() == posting_count * impact_size);
+    return index;
+}
+
+void FrozenIndex::AddWord(const map<int, double>& postings, double inverse_document_freq) {
+    inverse_document_freqs_.push_back(inverse_document_freq);
+    double max_term_freq = 0.0;
+    int documents[BLOCK_SIZE];
+    uint32_t counts[BLOCK_SIZE];
+    size_t in_block = 0;
+    int previous_document = 0;
+    for (const auto [document_id, term_freq] : postings) {
+        if (format_ == PostingFormat::PLAIN) {
+            document_ids_.push_back(document_id);
+            term_freqs_.push_back(term_freq);
+        } else {
+            documents[in_block] = document_id;
+            counts[in_block] = static_cast<uint32_t>(lround(term_freq / inverse_document_lengths_[document_id]));
+        }
+        max_term_freq = max(max_term_freq, term_freq);
+        if (in_block == 0) {
+            block_max_term_freqs_.push_back(term_freq);
+            block_last_documents_.push_back(document_id);
+        } else {
+            block_max_term_freqs_.mutable_back() = max(block_max_term_freqs_.back(), term_freq);
+            block_last_documents_.mutable_back() = document_id;
+        }
+        if (++in_block == BLOCK_SIZE) {
+            if (format_ == PostingFormat::COMPRESSED) {
+                EncodeBlock(documents, counts, in_block, previous_document);
+            }
+            previous_document = document_id;
+            in_block = 0;
+        }
+    }
+    if (format_ == PostingFormat::COMPRESSED && in_block > 0) {
+        EncodeBlock(documents, counts, in_block, previous_document);
+    }
+    offsets_.push_back(offsets_.back() + postings.size());
+    max_term_freqs_.push_back(max_term_freq);
+    block_offsets_.push_back(block_max_term_freqs_.size());
+}
+
+void FrozenIndex::EncodeBlock(const int* documents, const uint32_t* counts, size_t length, int previous_document) {
+    // отступ за концом данных нужен декодеру только в конце буфера
+    if (!data_.empty()) {
+        data_.resize(data_.size() - STREAM_VBYTE_PADDING);
+    }
+    block_data_offsets_.push_back(data_.size());
+    uint32_t deltas[BLOCK_SIZE];
+    copy(documents, documents + length, deltas);
+    DeltaEncode(deltas, length, static_cast<uint32_t>(previous_document));
+    vector<uint8_t> block;
+    EncodeStreamVByte(deltas, length, block);
+    EncodeStreamVByte(counts, length, block);
+    block.resize(block.size() + STREAM_VBYTE_PADDING);
+    data_.append(block.data(), block.size());
+}
+
+void FrozenIndex::DecodeBlock(size_t word_index, size_t block, int* documents, double* term_freqs) const {
+    const size_t global_block = block_offsets_[word_index] + block;
+    const size_t length = GetBlockLength(word_index, block);
+    const uint32_t base = block == 0 ? 0 : static_cast<uint32_t>(block_last_documents_[global_block - 1]);
+    uint32_t values[BLOCK_SIZE];
+    const uint8_t* in = DecodeStreamVByte(data_.data() + block_data_offsets_[global_block], length, values);
+    DeltaDecode(values, length, base);
+    for (size_t i = 0; i < length; ++i) {
+        documents[i] = static_cast<int>(values[i]);
+    }
+    DecodeStreamVByte(in, length, values);
+    for (size_t i = 0; i < length; ++i) {
+        term_freqs[i] = values[i] * inverse_document_lengths_[documents[i]];
+    }
+}
+
+size_t FrozenIndex::GetBlockLength(size_t word_index, size_t block) const {
+    return min(BLOCK_SIZE, GetDocumentCount(word_index) - block * BLOCK_SIZE);
+}
+
+size_t FrozenIndex::FindBlock(size_t word_index, size_t block, int document) const {
+    const auto first = block_last_documents_.begin() + block_offsets_[word_index];
+    const auto last = block_last_documents_.begin() + block_offsets_[word_index + 1];
+    return lower_bound(first + block, last, document) - first;
+}
+
+void FrozenIndex::QuantizeImpacts(ImpactPrecision precision) {
+    impact_precision_ = precision;
+    impact_scale_ = 1.0;
+    impacts_.clear();
+    if (precision == ImpactPrecision::EXACT) {
+        return;
+    }
+    double max_impact = 0.0;
+    for (size_t word_index = 0; word_index < GetWordCount(); ++word_index) {
+        max_impact = max(max_impact, max_term_freqs_[word_index] * inverse_document_freqs_[word_index]);
+    }
+    const double levels = precision == ImpactPrecision::BITS_8 ? 255.0 : 65535.0;
+    if (max_impact > 0.0) {
+        impact_scale_ = max_impact / levels;
+    }
+    const size_t impact_size = precision == ImpactPrecision::BITS_8 ? 1 : 2;
+    impacts_.resize(offsets_.back() * impact_size);
+    uint8_t* const impacts = impacts_.mutable_data();
+    for (size_t word_index = 0; word_index < GetWordCount(); ++word_index) {
+        const double inverse_document_freq = inverse_document_freqs_[word_index];
+        VisitPostingsInRange(word_index, 0, numeric_limits<int>::max(),
+            [&](int, double term_freq, size_t posting) {
+                const auto impact = static_cast<uint32_t>(
+                        min(levels, round(term_freq * inverse_document_freq / impact_scale_)));
+                if (impact_size == 1) {
+                    impacts[posting] = static_cast<uint8_t>(impact);
+                } else {
+                    impacts[2 * posting] = static_cast<uint8_t>(impact);
+                    impacts[2 * posting + 1] = static_cast<uint8_t>(impact >> 8);
+                }
+            });
+    }
+}
+
+PostingFormat FrozenIndex::GetFormat() const {
+    return format_;
+}
+
+ImpactPrecision FrozenIndex::GetImpactPrecision() const {
+    return impact_precision_;
+}
+
+double FrozenIndex::GetImpactScale() const {
+    return impact_scale_;
+}
+
+size_t FrozenIndex::GetWordCount() const {
+    return inverse_document_freqs_.size();
+}
+
+size_t FrozenIndex::GetDocumentCount(size_t word_index) const {
+    return offsets_[word_index + 1] - offsets_[word_index];
+}
+
+double FrozenIndex::GetInverseDocumentFreq(size_t word_index) const {
+    return inverse_document_freqs_[word_index];
+}
+
+bool FrozenIndex::Contains(size_t word_index, int document_id) const {
+    if (format_ == PostingFormat::PLAIN) {
+        const auto first = document_ids_.begin() + offsets_[word_index];
+        const auto last = document_ids_.begin() + offsets_[word_index + 1];
+        return binary_search(first, last, document_id);
+    }
+    const size_t block = FindBlock(word_index, 0, document_id);
+    if (block == block_offsets_[word_index + 1] - block_offsets_[word_index]) {
+        return false;
+    }
+    int documents[BLOCK_SIZE];
+    double term_freqs[BLOCK_SIZE];
+    DecodeBlock(word_index, block, documents, term_freqs);
+    return binary_search(documents, documents + GetBlockLength(word_index, block), document_id);
+}
+
+FrozenIndex::Cursor::Cursor(const FrozenIndex& index, size_t word_index, int first_document, int last_document)
+    : index_(&index)
+    , word_index_(word_index)
+    , first_block_(index.block_offsets_[word_index])
+    , block_count_(index.block_offsets_[word_index + 1] - index.block_offsets_[word_index])
+    , last_document_(last_document) {
+    LoadBlock(index.FindBlock(word_index, 0, first_document));
+    NextGeq(first_document);
+}
+
+FrozenIndex::Cursor::Cursor(const Cursor& other) {
+    *this = other;
+}
+
+FrozenIndex::Cursor& FrozenIndex::Cursor::operator=(const Cursor& other) {
+    index_ = other.index_;
+    word_index_ = other.word_index_;
+    first_block_ = other.first_block_;
+    block_count_ = other.block_count_;
+    last_document_ = other.last_document_;
+    block_ = other.block_;
+    block_length_ = other.block_length_;
+    position_ = other.position_;
+    documents_ = other.documents_;
+    term_freqs_ = other.term_freqs_;
+    shallow_block_ = other.shallow_block_;
+    if (other.documents_ == other.document_buffer_) {
+        // декодированный блок живёт в самом курсоре
+        copy(other.document_buffer_, other.document_buffer_ + block_length_, document_buffer_);
+        copy(other.term_freq_buffer_, other.term_freq_buffer_ + block_length_, term_freq_buffer_);
+        documents_ = document_buffer_;
+        term_freqs_ = term_freq_buffer_;
+    }
+    return *this;
+}
+
+void FrozenIndex::Cursor::LoadBlock(size_t block) {
+    block_ = block;
+    position_ = 0;
+    if (block_ >= block_count_) {
+        return;
+    }
+    block_length_ = index_->GetBlockLength(word_index_, block_);
+    if (index_->format_ == PostingFormat::PLAIN) {
+        const size_t begin = index_->offsets_[word_index_] + block_ * BLOCK_SIZE;
+        documents_ = index_->document_ids_.data() + begin;
+        term_freqs_ = index_->term_freqs_.data() + begin;
+    } else {
+        index_->DecodeBlock(word_index_, block_, document_buffer_, term_freq_buffer_);
+        documents_ = document_buffer_;
+        term_freqs_ = term_freq_buffer_;
+    }
+}
+
+void FrozenIndex::Cursor::NextGeq(int document) {
+    if (block_ >= block_count_ || documents_[position_] >= document) {
+        return;
+    }
+    if (index_->block_last_documents_[first_block_ + block_] < document) {
+        LoadBlock(index_->FindBlock(word_index_, block_ + 1, document));
+        if (block_ >= block_count_) {
+            return;
+        }
+    }
+    // последний документ блока не меньше document, поиск не выйдет за блок
+    position_ = lower_bound(documents_ + position_, documents_ + block_length_, document) - documents_;
+}
+
+double FrozenIndex::Cursor::GetBlockMaxTermFreq(int document, int& block_last_document) {
+    shallow_block_ = max(shallow_block_, block_);
+    if (shallow_block_ < block_count_ && index_->block_last_documents_[first_block_ + shallow_block_] < document) {
+        shallow_block_ = index_->FindBlock(word_index_, shallow_block_ + 1, document);
+    }
+    if (shallow_block_ >= block_count_) {
+        // документ за концом списка: слово в нём не встречается
+        block_last_document = numeric_limits<int>::max();
+        return 0.0;
+    }
+    block_last_document = index_->block_last_documents_[first_block_ + shallow_block_];
+    return index_->block_max_term_freqs_[first_block_ + shallow_block_];
+}
@@ -0,0 +1,229 @@
+#pragma once
+
+#include "frozen_array.h"
+#include "snapshot.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+enum class PostingFormat {
+    PLAIN,       // номера документов и частоты в несжатых массивах
+    COMPRESSED,  // разности номеров и число вхождений слова в Stream VByte
+};
+
+// Точность весов слов (tf * idf), по которым считается релевантность.
+// Квантованные веса - целые 0..2^bits-1 с общим для индекса шагом
+// scale = max(tf * idf) / (2^bits - 1). Вклад слова отличается от точного
+// не более чем на scale / 2, релевантность документа - не более чем на
+// (число плюс-слов запроса) * scale / 2
+enum class ImpactPrecision {
+    EXACT,
+    BITS_16,
+    BITS_8,
+};
+
+// Неизменяемый индекс в формате CSR: смещения списков слов в общие
+// массивы номеров документов и частот, отсортированные по номеру.
+// Слова добавляются по возрастанию TermId, так что word_index совпадает
+// с номером слова в словаре; IDF вычисляется один раз при заморозке.
+// Списки разбиты на блоки по BLOCK_SIZE документов; для каждого блока
+// хранятся последний номер (для пропуска блоков) и максимальная частота
+// (для отсечения). В сжатом формате блоки декодируются целиком
+class FrozenIndex {
+public:
+    static constexpr size_t BLOCK_SIZE = 128;
+
+    FrozenIndex() = default;
+    // document_word_counts - число слов документа по его номеру:
+    // в сжатом формате частота восстанавливается как вхождения / число слов
+    FrozenIndex(PostingFormat format, const std::vector<int>& document_word_counts);
+
+    // Курсор по списку документов слова в диапазоне номеров документов
+    class Cursor {
+    public:
+        Cursor(const FrozenIndex& index, size_t word_index, int first_document, int last_document);
+        Cursor(const Cursor& other);
+        Cursor& operator=(const Cursor& other);
+
+        bool IsValid() const {
+            return block_ < block_count_ && documents_[position_] < last_document_;
+        }
+        int GetDocument() const {
+            return documents_[position_];
+        }
+        double GetTermFreq() const {
+            return term_freqs_[position_];
+        }
+        uint32_t GetImpact() const {
+            return index_->GetImpact(index_->offsets_[word_index_] + block_ * BLOCK_SIZE + position_);
+        }
+        double GetMaxTermFreq() const {
+            return index_->max_term_freqs_[word_index_];
+        }
+        void Next() {
+            if (++position_ == block_length_) {
+                LoadBlock(block_ + 1);
+            }
+        }
+        // Переход к первому документу с номером не меньше document
+        void NextGeq(int document);
+        // Максимальная частота в блоке, где мог бы оказаться document.
+        // Сдвигается только указатель блоков, сам курсор остаётся на месте.
+        // В block_last_document - последний номер документа в блоке
+        double GetBlockMaxTermFreq(int document, int& block_last_document);
+
+    private:
+        const FrozenIndex* index_;
+        size_t word_index_;
+        size_t first_block_;
+        size_t block_count_;
+        int last_document_;
+        size_t block_ = 0;
+        size_t block_length_ = 0;
+        size_t position_ = 0;
+        const int* documents_ = nullptr;
+        const double* term_freqs_ = nullptr;
+        size_t shallow_block_ = 0;
+        int document_buffer_[BLOCK_SIZE];
+        double term_freq_buffer_[BLOCK_SIZE];
+
+        void LoadBlock(size_t block);
+    };
+
+    void Reserve(size_t word_count, size_t posting_count);
+    // Загруженный индекс ссылается на данные снимка, а не копирует их
+    void Save(SnapshotWriter& writer) const;
+    static FrozenIndex Load(SnapshotReader& reader);
+    void AddWord(const std::map<int, double>& postings, double inverse_document_freq);
+
+    // Вычисляет квантованные веса для уже добавленных слов
+    void QuantizeImpacts(ImpactPrecision precision);
+
+    PostingFormat GetFormat() const;
+    ImpactPrecision GetImpactPrecision() const;
+    // Релевантность = сумма квантованных весов * GetImpactScale()
+    double GetImpactScale() const;
+    size_t GetWordCount() const;
+    size_t GetDocumentCount(size_t word_index) const;
+    double GetInverseDocumentFreq(size_t word_index) const;
+    bool Contains(size_t word_index, int document_id) const;
+
+    template <typename Func>
+    void ForEachPosting(size_t word_index, Func func) const;
+    template <typename Func>
+    void ForEachPostingInRange(size_t word_index, int first_document, int last_document, Func func) const;
+    // func(номер документа, квантованный вес)
+    template <typename Func>
+    void ForEachImpactInRange(size_t word_index, int first_document, int last_document, Func func) const;
+
+private:
+    PostingFormat format_ = PostingFormat::PLAIN;
+    FrozenArray<double> inverse_document_lengths_;
+
+    FrozenArray<double> inverse_document_freqs_;
+    FrozenArray<size_t> offsets_ = {0};
+    FrozenArray<double> max_term_freqs_;
+    // блоки слова word_index - [block_offsets_[word_index], block_offsets_[word_index + 1])
+    FrozenArray<size_t> block_offsets_ = {0};
+    FrozenArray<double> block_max_term_freqs_;
+    FrozenArray<int> block_last_documents_;
+
+    // PostingFormat::PLAIN
+    FrozenArray<int> document_ids_;
+    FrozenArray<double> term_freqs_;
+
+    // PostingFormat::COMPRESSED: начало каждого блока в data_
+    FrozenArray<size_t> block_data_offsets_;
+    FrozenArray<uint8_t> data_;
+
+    // квантованные веса в порядке документов, 1 или 2 байта на вес
+    ImpactPrecision impact_precision_ = ImpactPrecision::EXACT;
+    double impact_scale_ = 1.0;
+    FrozenArray<uint8_t> impacts_;
+
+    size_t GetBlockLength(size_t word_index, size_t block) const;
+    // Первый блок слова начиная с block, чей последний документ не меньше document
+    size_t FindBlock(size_t word_index, size_t block, int document) const;
+    void DecodeBlock(size_t word_index, size_t block, int* documents, double* term_freqs) const;
+    void EncodeBlock(const int* documents, const uint32_t* counts, size_t length, int previous_document);
+    uint32_t GetImpact(size_t posting) const;
+
+    // func(номер документа, частота, позиция в общем порядке документов)
+    template <typename Func>
+    void VisitPostingsInRange(size_t word_index, int first_document, int last_document, Func func) const;
+};
+
+template <typename Func>
+void FrozenIndex::ForEachPosting(size_t word_index, Func func) const {
+    if (format_ == PostingFormat::PLAIN) {
+        const size_t last = offsets_[word_index + 1];
+        for (size_t i = offsets_[word_index]; i < last; ++i) {
+            func(document_ids_[i], term_freqs_[i]);
+        }
+        return;
+    }
+    int documents[BLOCK_SIZE];
+    double term_freqs[BLOCK_SIZE];
+    const size_t block_count = block_offsets_[word_index + 1] - block_offsets_[word_index];
+    for (size_t block = 0; block < block_count; ++block) {
+        DecodeBlock(word_index, block, documents, term_freqs);
+        const size_t length = GetBlockLength(word_index, block);
+        for (size_t i = 0; i < length; ++i) {
+            func(documents[i], term_freqs[i]);
+        }
+    }
+}
+
+template <typename Func>
+void FrozenIndex::ForEachPostingInRange(size_t word_index, int first_document, int last_document, Func func) const {
+    VisitPostingsInRange(word_index, first_document, last_document,
+                         [&func](int document, double term_freq, size_t) {
+                             func(document, term_freq);
+                         });
+}
+
+template <typename Func>
+void FrozenIndex::ForEachImpactInRange(size_t word_index, int first_document, int last_document, Func func) const {
+    VisitPostingsInRange(word_index, first_document, last_document,
+                         [this, &func](int document, double, size_t posting) {
+                             func(document, GetImpact(posting));
+                         });
+}
+
+inline uint32_t FrozenIndex::GetImpact(size_t posting) const {
+    if (impact_precision_ == ImpactPrecision::BITS_8) {
+        return impacts_[posting];
+    }
+    return impacts_[2 * posting] | (static_cast<uint32_t>(impacts_[2 * posting + 1]) << 8);
+}
+
+template <typename Func>
+void FrozenIndex::VisitPostingsInRange(size_t word_index, int first_document, int last_document, Func func) const {
+    if (format_ == PostingFormat::PLAIN) {
+        const auto begin = document_ids_.begin() + offsets_[word_index];
+        const auto end = document_ids_.begin() + offsets_[word_index + 1];
+        for (size_t i = std::lower_bound(begin, end, first_document) - document_ids_.begin();
+             i < offsets_[word_index + 1] && document_ids_[i] < last_document; ++i) {
+            func(document_ids_[i], term_freqs_[i], i);
+        }
+        return;
+    }
+    int documents[BLOCK_SIZE];
+    double term_freqs[BLOCK_SIZE];
+    const size_t block_count = block_offsets_[word_index + 1] - block_offsets_[word_index];
+    for (size_t block = FindBlock(word_index, 0, first_document); block < block_count; ++block) {
+        DecodeBlock(word_index, block, documents, term_freqs);
+        const size_t length = GetBlockLength(word_index, block);
+        const size_t block_begin = offsets_[word_index] + block * BLOCK_SIZE;
+        for (size_t i = std::lower_bound(documents, documents + length, first_document) - documents;
+             i < length; ++i) {
+            if (documents[i] >= last_document) {
+                return;
+            }
+            func(documents[i], term_freqs[i], block_begin + i);
+        }
+    }
+}
@@ -1,6 +1,8 @@
 #include "search_server.h"
 #include "log_duration.h"
 #include "process_queries.h"
+#include <algorithm>
+#include <cstdlib>
 #include <execution>
 #include <iostream>
 #include <random>
@@ -47,7 +49,7 @@ vector<string> GenerateQueries(mt19937& generator, const vector<string>& diction
     return queries;
 }
 template <typename ExecutionPolicy>
-void Test(string_view mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
+void Test(const string& mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
     LOG_DURATION(mark);
     double total_relevance = 0;
     for (const string_view query : queries) {
@@ -57,6 +59,34 @@ void Test(string_view mark, const SearchServer& search_server, const vector<stri
     }
     cout << total_relevance << endl;
 }
+// Доля документов точной выдачи, оставшихся в выдаче с квантованными весами
+void TestQuantizedOverlap(SearchServer& search_server, const vector<string>& queries, ImpactPrecision precision,
+                          double min_overlap) {
+    search_server.Freeze();
+    vector<vector<Document>> exact_results;
+    for (const string_view query : queries) {
+        exact_results.push_back(search_server.FindTopDocuments(query));
+    }
+    search_server.Freeze(PostingFormat::PLAIN, precision);
+    size_t total = 0;
+    size_t found = 0;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const auto results = search_server.FindTopDocuments(queries[i]);
+        for (const Document& document : exact_results[i]) {
+            ++total;
+            found += count_if(results.begin(), results.end(), [&document](const Document& other) {
+                return other.id == document.id;
+            });
+        }
+    }
+    const double overlap = total == 0 ? 1.0 : static_cast<double>(found) / total;
+    cout << "top-k overlap "s << overlap << endl;
+    // проверка и в сборке с NDEBUG: программа служит тестом квантования
+    if (overlap < min_overlap) {
+        cerr << "top-k overlap "s << overlap << " is below "s << min_overlap << endl;
+        exit(EXIT_FAILURE);
+    }
+}
 #define TEST(policy) Test(#policy, search_server, queries, execution::policy)
 int main() {
     mt19937 generator;
@@ -69,4 +99,6 @@ int main() {
     const auto queries = GenerateQueries(generator, dictionary, 100, 70);
     TEST(seq);
     TEST(par);
+    TestQuantizedOverlap(search_server, queries, ImpactPrecision::BITS_16, 0.99);
+    TestQuantizedOverlap(search_server, queries, ImpactPrecision::BITS_8, 0.9);
 }
\ No newline at end of file
@@ -0,0 +1,141 @@
+#include "posting_codec.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define POSTING_CODEC_X86 1
+#endif
+
+using namespace std;
+
+namespace {
+
+size_t GetValueLength(uint32_t value) {
+    if (value < (1u << 8)) {
+        return 1;
+    }
+    if (value < (1u << 16)) {
+        return 2;
+    }
+    if (value < (1u << 24)) {
+        return 3;
+    }
+    return 4;
+}
+
+struct DecodeTables {
+    // суммарная длина данных четвёрки по управляющему байту
+    array<uint8_t, 256> lengths;
+    // маски pshufb: раскладывают байты четвёрки по 32-битным ячейкам
+    array<array<uint8_t, 16>, 256> shuffles;
+
+    DecodeTables() {
+        for (int control = 0; control < 256; ++control) {
+            uint8_t offset = 0;
+            for (int lane = 0; lane < 4; ++lane) {
+                const int length = ((control >> (2 * lane)) & 3) + 1;
+                for (int byte = 0; byte < 4; ++byte) {
+                    shuffles[control][4 * lane + byte] = byte < length ? offset + byte : 0xFF;
+                }
+                offset += length;
+            }
+            lengths[control] = offset;
+        }
+    }
+};
+
+const DecodeTables& GetDecodeTables() {
+    static const DecodeTables tables;
+    return tables;
+}
+
+const uint8_t* DecodeScalar(const uint8_t* controls, const uint8_t* data, size_t count, uint32_t* values) {
+    for (size_t i = 0; i < count; ++i) {
+        const size_t length = ((controls[i / 4] >> (2 * (i % 4))) & 3) + 1;
+        uint32_t value = 0;
+        for (size_t byte = 0; byte < length; ++byte) {
+            value |= static_cast<uint32_t>(data[byte]) << (8 * byte);
+        }
+        values[i] = value;
+        data += length;
+    }
+    return data;
+}
+
+#ifdef POSTING_CODEC_X86
+__attribute__((target("ssse3")))
+const uint8_t* DecodeSsse3(const uint8_t* controls, const uint8_t* data, size_t count, uint32_t* values) {
+    const DecodeTables& tables = GetDecodeTables();
+    size_t i = 0;
+    // неполную последнюю четвёрку декодируем скалярно
+    for (; i + 4 <= count; i += 4) {
+        const uint8_t control = controls[i / 4];
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        const __m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.shuffles[control].data()));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i), _mm_shuffle_epi8(bytes, shuffle));
+        data += tables.lengths[control];
+    }
+    return DecodeScalar(controls + i / 4, data, count - i, values + i);
+}
+
+bool HasSsse3() {
+    static const bool has_ssse3 = __builtin_cpu_supports("ssse3");
+    return has_ssse3;
+}
+#endif
+
+}  // namespace
+
+void EncodeStreamVByte(const uint32_t* values, size_t count, vector<uint8_t>& out) {
+    const size_t control_offset = out.size();
+    out.resize(control_offset + (count + 3) / 4, 0);
+    for (size_t i = 0; i < count; ++i) {
+        const size_t length = GetValueLength(values[i]);
+        out[control_offset + i / 4] |= static_cast<uint8_t>((length - 1) << (2 * (i % 4)));
+        for (size_t byte = 0; byte < length; ++byte) {
+            out.push_back(static_cast<uint8_t>(values[i] >> (8 * byte)));
+        }
+    }
+}
+
+const uint8_t* DecodeStreamVByte(const uint8_t* in, size_t count, uint32_t* values) {
+    const uint8_t* controls = in;
+    const uint8_t* data = in + (count + 3) / 4;
+#ifdef POSTING_CODEC_X86
+    if (HasSsse3()) {
+        return DecodeSsse3(controls, data, count, values);
+    }
+#endif
+    return DecodeScalar(controls, data, count, values);
+}
+
+void DeltaEncode(uint32_t* values, size_t count, uint32_t base) {
+    for (size_t i = count; i > 0; --i) {
+        values[i - 1] -= i > 1 ? values[i - 2] : base;
+    }
+}
+
+void DeltaDecode(uint32_t* values, size_t count, uint32_t base) {
+    size_t i = 0;
+#ifdef POSTING_CODEC_X86
+    // префиксная сумма четвёрки за два сдвига и сложения (SSE2)
+    __m128i previous = _mm_set1_epi32(static_cast<int>(base));
+    for (; i + 4 <= count; i += 4) {
+        __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+        current = _mm_add_epi32(current, _mm_slli_si128(current, 4));
+        current = _mm_add_epi32(current, _mm_slli_si128(current, 8));
+        current = _mm_add_epi32(current, previous);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i), current);
+        previous = _mm_shuffle_epi32(current, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+    if (i > 0) {
+        base = values[i - 1];
+    }
+#endif
+    for (; i < count; ++i) {
+        base += values[i];
+        values[i] = base;
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Кодирование блоков целых чисел в формате Stream VByte: на каждые четыре
+// числа один управляющий байт с длинами (1-4 байта) и плотные байты данных.
+// Декодирование использует SSSE3, если процессор его поддерживает,
+// иначе работает скалярная версия с тем же результатом
+
+const size_t STREAM_VBYTE_PADDING = 16;
+
+// Дописывает count чисел в out
+void EncodeStreamVByte(const uint32_t* values, size_t count, std::vector<uint8_t>& out);
+
+// Читает count чисел, возвращает указатель на байт за блоком.
+// SIMD-версия читает по 16 байт, поэтому за концом данных должно быть
+// доступно ещё STREAM_VBYTE_PADDING байт
+const uint8_t* DecodeStreamVByte(const uint8_t* in, size_t count, uint32_t* values);
+
+// Разности соседних чисел блока: values[i] -= values[i - 1], values[0] -= base
+void DeltaEncode(uint32_t* values, size_t count, uint32_t base);
+
+// Обратное преобразование: префиксные суммы, начиная с base
+void DeltaDecode(uint32_t* values, size_t count, uint32_t base);
@@ -1,28 +1,76 @@
-#include <execution>
+#include <algorithm>
+#include <thread>
+#include <utility>
 #include <vector>
 #include "document.h"
 #include "process_queries.h"
+#include "top_documents.h"
 
+namespace {
 
+// наибольшее число запросов в группе с общим обходом списков документов;
+// небольшие пакеты делятся на группы поровну между потоками
+const size_t QUERY_GROUP_SIZE = 64;
+
+// Пул на всё время работы программы, чтобы не создавать потоки на каждый пакет
+QueryExecutor& GetDefaultExecutor() {
+    static QueryExecutor executor(std::max(1u, std::thread::hardware_concurrency()), QUERY_GROUP_SIZE);
+    return executor;
+}
+
+}  // namespace
 
 std::vector<std::vector<Document>> ProcessQueries(
+    QueryExecutor& executor,
     const SearchServer& search_server,
     const std::vector<std::string>& queries) {
     std::vector<std::vector<Document>> results(queries.size());
-    std::transform(std::execution::par, queries.begin(), queries.end(), results.begin(),
-        [&search_server](const std::string& query) { return search_server.FindTopDocuments(query); });
+    executor.Run(search_server, queries.begin(), queries.end(),
+        [&results](size_t query_index, QueryExecutor::DocumentRange documents) {
+            results[query_index].assign(documents.begin(), documents.end());
+        });
     return results;
 }
 
+std::vector<std::vector<Document>> ProcessQueries(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries) {
+    return ProcessQueries(GetDefaultExecutor(), search_server, queries);
+}
+
+JoinedQueryResults::JoinedQueryResults(std::vector<Document> documents, std::vector<size_t> offsets)
+    : documents_(std::move(documents))
+    , offsets_(std::move(offsets)) {
+}
+
 std::vector<Document> ProcessQueriesJoined(
+    QueryExecutor& executor,
     const SearchServer& search_server,
     const std::vector<std::string>& queries) {
-    std::vector<std::vector<Document>> results = ProcessQueries(search_server, queries);
     std::vector<Document> documents;
-    documents.reserve(std::accumulate(results.begin(), results.end(), 0,
-        [](int sum, const std::vector<Document>& docs) { return sum + docs.size(); }));
-    for (const auto& result : results) {
-        documents.insert(documents.end(), result.begin(), result.end());
-    }
+    std::vector<size_t> offsets;
+    executor.RunJoined(search_server, queries, documents, offsets);
     return documents;
-}
\ No newline at end of file
+}
+
+std::vector<Document> ProcessQueriesJoined(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries) {
+    return ProcessQueriesJoined(GetDefaultExecutor(), search_server, queries);
+}
+
+JoinedQueryResults ProcessQueriesFlat(
+    QueryExecutor& executor,
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries) {
+    std::vector<Document> documents;
+    std::vector<size_t> offsets;
+    executor.RunJoined(search_server, queries, documents, offsets);
+    return JoinedQueryResults(std::move(documents), std::move(offsets));
+}
+
+JoinedQueryResults ProcessQueriesFlat(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries) {
+    return ProcessQueriesFlat(GetDefaultExecutor(), search_server, queries);
+}
@@ -1,14 +1,71 @@
 #pragma once
 
+#include <cstddef>
 #include <vector>
 
 #include "document.h"
+#include "paginator.h"
+#include "query_executor.h"
 #include "search_server.h"
 
+// Результаты в порядке запросов
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries);
 
+std::vector<std::vector<Document>> ProcessQueries(
+    QueryExecutor& executor,
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries);
+
+// Результаты пакета в одном буфере: документы всех запросов подряд в
+// порядке запросов, границы запросов - смещения в буфере
+class JoinedQueryResults {
+public:
+    using Iterator = std::vector<Document>::const_iterator;
+
+    JoinedQueryResults() = default;
+    // offsets: query_count + 1 возрастающих смещений, первое 0, последнее documents.size()
+    JoinedQueryResults(std::vector<Document> documents, std::vector<size_t> offsets);
+
+    size_t GetQueryCount() const {
+        return offsets_.size() - 1;
+    }
+    IteratorRange<Iterator> operator[](size_t query_index) const {
+        return {documents_.begin() + offsets_[query_index], documents_.begin() + offsets_[query_index + 1]};
+    }
+
+    Iterator begin() const {
+        return documents_.begin();
+    }
+    Iterator end() const {
+        return documents_.end();
+    }
+    size_t size() const {
+        return documents_.size();
+    }
+
+private:
+    std::vector<Document> documents_;
+    std::vector<size_t> offsets_ = {0};
+};
+
+// Документы всех запросов подряд в порядке запросов, без границ запросов
+std::vector<Document> ProcessQueriesJoined(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries);
+
 std::vector<Document> ProcessQueriesJoined(
+    QueryExecutor& executor,
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries);
+
+// Как ProcessQueriesJoined, с границами запросов
+JoinedQueryResults ProcessQueriesFlat(
     const SearchServer& search_server,
-    const std::vector<std::string>& queries);
\ No newline at end of file
+    const std::vector<std::string>& queries);
+
+JoinedQueryResults ProcessQueriesFlat(
+    QueryExecutor& executor,
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries);
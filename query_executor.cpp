@@ -0,0 +1,244 @@
+#include "query_executor.h"
+
+#include <algorithm>
+#include <numeric>
+
+using namespace std;
+
+QueryExecutor::QueryExecutor(size_t thread_count, size_t group_size)
+    : group_size_(max<size_t>(1, group_size)) {
+    thread_count = max<size_t>(1, thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers_.push_back(make_unique<Worker>());
+    }
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads_.emplace_back([this, i] {
+            RunWorker(i);
+        });
+    }
+}
+
+QueryExecutor::~QueryExecutor() {
+    {
+        lock_guard lock(sleep_mutex_);
+        is_stopping_ = true;
+    }
+    work_available_.notify_all();
+    for (thread& thread : threads_) {
+        thread.join();
+    }
+}
+
+size_t QueryExecutor::GetThreadCount() const {
+    return threads_.size();
+}
+
+size_t QueryExecutor::GetGroupSize() const {
+    return group_size_;
+}
+
+void QueryExecutor::Submit(Slot* slot) {
+    Worker& worker = *workers_[next_worker_.fetch_add(1, memory_order_relaxed) % workers_.size()];
+    {
+        // под мьютексом, чтобы засыпающий поток не пропустил задачу; до
+        // публикации, иначе взявший задачу поток уменьшит счётчик раньше
+        // и беззнаковый счётчик перейдёт через ноль
+        lock_guard lock(sleep_mutex_);
+        pending_count_.fetch_add(1, memory_order_relaxed);
+    }
+    {
+        lock_guard lock(worker.mutex);
+        worker.tasks.push_back(slot);
+    }
+    work_available_.notify_one();
+}
+
+QueryExecutor::Slot* QueryExecutor::TakeTask(size_t worker_index) {
+    {
+        Worker& worker = *workers_[worker_index];
+        lock_guard lock(worker.mutex);
+        if (!worker.tasks.empty()) {
+            Slot* slot = worker.tasks.front();
+            worker.tasks.pop_front();
+            return slot;
+        }
+    }
+    for (size_t i = 1; i < workers_.size(); ++i) {
+        Worker& victim = *workers_[(worker_index + i) % workers_.size()];
+        lock_guard lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            Slot* slot = victim.tasks.back();
+            victim.tasks.pop_back();
+            return slot;
+        }
+    }
+    return nullptr;
+}
+
+void QueryExecutor::RunWorker(size_t worker_index) {
+    while (true) {
+        if (Slot* slot = TakeTask(worker_index)) {
+            pending_count_.fetch_sub(1, memory_order_relaxed);
+            Execute(*slot);
+            continue;
+        }
+        unique_lock lock(sleep_mutex_);
+        work_available_.wait(lock, [this] {
+            return is_stopping_ || pending_count_.load(memory_order_relaxed) > 0;
+        });
+        if (is_stopping_) {
+            return;
+        }
+    }
+}
+
+void QueryExecutor::Execute(Slot& slot) {
+    Batch& batch = *slot.batch;
+    try {
+        if (slot.job) {
+            slot.job(slot);
+        } else {
+            slot.query_views.assign(slot.queries.begin(), slot.queries.begin() + slot.query_count);
+            slot.documents.clear();
+            slot.offsets.assign(1, 0);
+            batch.search_server->FindTopDocumentsBatch(slot.query_views, DocumentStatus::ACTUAL,
+                                                       MAX_RESULT_DOCUMENT_COUNT, slot.documents, slot.offsets);
+        }
+    } catch (...) {
+        slot.error = current_exception();
+    }
+    // оповещение под мьютексом: после is_ready Run может завершиться
+    // и разрушить batch, как только мьютекс освобождён
+    lock_guard lock(batch.mutex);
+    slot.is_ready = true;
+    batch.slot_ready.notify_one();
+}
+
+void QueryExecutor::Run(const SearchServer& search_server, const QuerySource& source, const ResultSink& sink,
+                        size_t max_in_flight) {
+    RunGroups(search_server, source, sink, max_in_flight, group_size_);
+}
+
+void QueryExecutor::RunGroups(const SearchServer& search_server, const QuerySource& source, const ResultSink& sink,
+                              size_t max_in_flight, size_t group_size) {
+    Batch batch;
+    batch.search_server = &search_server;
+    vector<Slot> slots(max<size_t>(1, max_in_flight / group_size));
+    for (Slot& slot : slots) {
+        slot.batch = &batch;
+    }
+    const auto wait_ready = [&batch](Slot& slot) {
+        unique_lock lock(batch.mutex);
+        batch.slot_ready.wait(lock, [&slot] {
+            return slot.is_ready;
+        });
+    };
+
+    // счётчики групп, не запросов
+    size_t read_count = 0;
+    size_t delivered_count = 0;
+    size_t query_index = 0;
+    bool is_source_empty = false;
+    try {
+        while (true) {
+            while (!is_source_empty && read_count - delivered_count < slots.size()) {
+                Slot& slot = slots[read_count % slots.size()];
+                slot.query_count = 0;
+                while (slot.query_count < group_size) {
+                    if (slot.queries.size() == slot.query_count) {
+                        slot.queries.emplace_back();
+                    }
+                    if (!source(slot.queries[slot.query_count])) {
+                        is_source_empty = true;
+                        break;
+                    }
+                    ++slot.query_count;
+                }
+                if (slot.query_count == 0) {
+                    break;
+                }
+                slot.is_ready = false;
+                Submit(&slot);
+                ++read_count;
+            }
+            if (delivered_count == read_count) {
+                break;
+            }
+
+            Slot& slot = slots[delivered_count % slots.size()];
+            wait_ready(slot);
+            ++delivered_count;
+            if (slot.error) {
+                rethrow_exception(exchange(slot.error, nullptr));
+            }
+            for (size_t i = 0; i < slot.query_count; ++i) {
+                sink(query_index++, DocumentRange(slot.documents.begin() + slot.offsets[i],
+                                                  slot.documents.begin() + slot.offsets[i + 1]));
+            }
+        }
+    } catch (...) {
+        // потоки пула ещё пишут в окно пакета
+        for (; delivered_count < read_count; ++delivered_count) {
+            wait_ready(slots[delivered_count % slots.size()]);
+        }
+        throw;
+    }
+}
+
+void QueryExecutor::Run(const SearchServer& search_server, istream& input, const ResultSink& sink,
+                        size_t max_in_flight) {
+    Run(search_server,
+        [&input](string& query) {
+            return static_cast<bool>(getline(input, query));
+        },
+        sink, max_in_flight);
+}
+
+void QueryExecutor::RunRanges(const SearchServer& search_server, size_t query_count,
+                              const function<void(Slot& slot, size_t first, size_t last)>& job) {
+    const size_t thread_count = GetThreadCount();
+    const size_t group_size = clamp<size_t>((query_count + thread_count - 1) / thread_count, 1, group_size_);
+    Batch batch;
+    batch.search_server = &search_server;
+    vector<Slot> slots((query_count + group_size - 1) / group_size);
+    for (size_t i = 0; i < slots.size(); ++i) {
+        const size_t first = i * group_size;
+        const size_t last = min(first + group_size, query_count);
+        slots[i].batch = &batch;
+        slots[i].job = [&job, first, last](Slot& slot) {
+            job(slot, first, last);
+        };
+        Submit(&slots[i]);
+    }
+    exception_ptr error;
+    for (Slot& slot : slots) {
+        unique_lock lock(batch.mutex);
+        batch.slot_ready.wait(lock, [&slot] {
+            return slot.is_ready;
+        });
+        if (slot.error && !error) {
+            error = slot.error;
+        }
+    }
+    if (error) {
+        rethrow_exception(error);
+    }
+}
+
+void QueryExecutor::RunJoined(const SearchServer& search_server, const vector<string>& queries,
+                              vector<Document>& documents, vector<size_t>& offsets) {
+    offsets.assign(queries.size() + 1, 0);
+    RunRanges(search_server, queries.size(), [&search_server, &queries, &offsets](Slot&, size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            offsets[i + 1] = search_server.CountTopDocuments(queries[i]);
+        }
+    });
+    partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    documents.resize(offsets.back());
+    RunRanges(search_server, queries.size(), [&search_server, &queries, &documents, &offsets](
+                                                 Slot& slot, size_t first, size_t last) {
+        slot.query_views.assign(queries.begin() + first, queries.begin() + last);
+        search_server.FindTopDocumentsBatch(slot.query_views, DocumentStatus::ACTUAL, MAX_RESULT_DOCUMENT_COUNT,
+                                            documents.data(), offsets.data() + first);
+    });
+}
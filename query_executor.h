@@ -0,0 +1,160 @@
+#pragma once
+
+#include "document.h"
+#include "paginator.h"
+#include "search_server.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <istream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Пул потоков для пакетов запросов FindTopDocuments. Потоки живут всё
+// время жизни пула, так что их буферы разбора и аккумуляторы релевантности
+// (thread_local в SearchServer) переиспользуются от запроса к запросу.
+// У каждого потока своя очередь задач; освободившийся поток забирает
+// задачи из чужих очередей.
+//
+// Запросы читаются из источника по мере освобождения места: прочитано и
+// не отдано не больше max_in_flight запросов, поэтому память не зависит
+// от размера пакета, а медленный получатель результатов притормаживает
+// чтение. Результаты отдаются по порядку запросов в вызывающем потоке.
+// Результаты группы запросов ранжируются в общий буфер места в окне, и
+// буферы переиспользуются, так что отдельного вектора на запрос нет.
+// Несколько Run могут выполняться одновременно на одном пуле.
+//
+// С group_size > 1 подряд идущие запросы собираются в группы, и группа
+// ранжируется одной задачей через FindTopDocumentsBatch, которая читает
+// общие слова группы один раз. Это выгодно для больших пакетов; запрос
+// потока ждёт, пока наберётся его группа. Ошибка запроса становится
+// ошибкой всей группы. Для диапазона запросов group_size - наибольший
+// размер группы: небольшой пакет делится на группы поровну между потоками,
+// чтобы оставаться параллельным
+class QueryExecutor {
+public:
+    // Записывает следующий запрос в query; false, когда запросы кончились
+    using QuerySource = std::function<bool(std::string& query)>;
+    using DocumentRange = IteratorRange<std::vector<Document>::const_iterator>;
+    // Результат запроса с номером query_index (с нуля, по порядку источника);
+    // documents действительны только во время вызова
+    using ResultSink = std::function<void(size_t query_index, DocumentRange documents)>;
+
+    static constexpr size_t DEFAULT_MAX_IN_FLIGHT = 1024;
+
+    explicit QueryExecutor(size_t thread_count = std::max(1u, std::thread::hardware_concurrency()),
+                           size_t group_size = 1);
+    ~QueryExecutor();
+    QueryExecutor(const QueryExecutor&) = delete;
+    QueryExecutor& operator=(const QueryExecutor&) = delete;
+
+    // Исключение запроса или получателя выбрасывается из Run после
+    // завершения уже начатых запросов; следующие запросы не читаются
+    void Run(const SearchServer& search_server, const QuerySource& source, const ResultSink& sink,
+             size_t max_in_flight = DEFAULT_MAX_IN_FLIGHT);
+    // Запросы - строки потока
+    void Run(const SearchServer& search_server, std::istream& input, const ResultSink& sink,
+             size_t max_in_flight = DEFAULT_MAX_IN_FLIGHT);
+    template <typename InputIt>
+    void Run(const SearchServer& search_server, InputIt first, InputIt last, const ResultSink& sink,
+             size_t max_in_flight = DEFAULT_MAX_IN_FLIGHT);
+
+    // Результаты всех queries в documents подряд, запрос i -
+    // [offsets[i], offsets[i + 1]). Сначала потоки считают число документов
+    // каждого запроса, по ним documents выделяется один раз, и группы
+    // ранжируются прямо в свои части буфера. search_server не должен
+    // меняться до конца вызова
+    void RunJoined(const SearchServer& search_server, const std::vector<std::string>& queries,
+                   std::vector<Document>& documents, std::vector<size_t>& offsets);
+
+    size_t GetThreadCount() const;
+    size_t GetGroupSize() const;
+
+private:
+    struct Batch;
+
+    // Место для группы запросов в окне пакета; строки и буферы переиспользуются
+    struct Slot {
+        Batch* batch = nullptr;
+        std::vector<std::string> queries;
+        std::vector<std::string_view> query_views;
+        size_t query_count = 0;
+        // документы запросов группы подряд, запрос i - [offsets[i], offsets[i + 1])
+        std::vector<Document> documents;
+        std::vector<size_t> offsets;
+        // если задана, выполняется вместо ранжирования queries
+        std::function<void(Slot& slot)> job;
+        std::exception_ptr error;
+        bool is_ready = false;
+    };
+
+    struct Batch {
+        const SearchServer* search_server;
+        std::mutex mutex;
+        std::condition_variable slot_ready;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Slot*> tasks;
+    };
+
+    const size_t group_size_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> next_worker_{0};
+
+    // задачи, поставленные и ещё не взятые потоками; растёт до публикации
+    // задачи, так что не меньше числа задач в очередях
+    std::atomic<size_t> pending_count_{0};
+    std::mutex sleep_mutex_;
+    std::condition_variable work_available_;
+    bool is_stopping_ = false;
+
+    // Run с группами не больше group_size запросов
+    void RunGroups(const SearchServer& search_server, const QuerySource& source, const ResultSink& sink,
+                   size_t max_in_flight, size_t group_size);
+    // Разбивает [0, query_count) на группы и выполняет job(slot, first, last)
+    // для каждой группы в потоках пула; первая ошибка выбрасывается после
+    // завершения всех групп
+    void RunRanges(const SearchServer& search_server, size_t query_count,
+                   const std::function<void(Slot& slot, size_t first, size_t last)>& job);
+    void Submit(Slot* slot);
+    // Своя задача с начала очереди, иначе чужая с конца
+    Slot* TakeTask(size_t worker_index);
+    void RunWorker(size_t worker_index);
+    static void Execute(Slot& slot);
+};
+
+template <typename InputIt>
+void QueryExecutor::Run(const SearchServer& search_server, InputIt first, InputIt last, const ResultSink& sink,
+                        size_t max_in_flight) {
+    size_t group_size = group_size_;
+    if constexpr (std::is_base_of_v<std::forward_iterator_tag,
+                                    typename std::iterator_traits<InputIt>::iterator_category>) {
+        const size_t query_count = static_cast<size_t>(std::distance(first, last));
+        const size_t thread_count = GetThreadCount();
+        group_size = std::clamp<size_t>((query_count + thread_count - 1) / thread_count, 1, group_size_);
+    }
+    RunGroups(search_server,
+        [&first, last](std::string& query) {
+            if (first == last) {
+                return false;
+            }
+            query.assign(std::string_view(*first));
+            ++first;
+            return true;
+        },
+        sink, max_in_flight, group_size);
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Плотный массив релевантностей по номерам документов со списком
+// затронутых ячеек. Очистка стоит O(число затронутых), а не O(размер),
+// поэтому один экземпляр переиспользуется между запросами
+class RelevanceAccumulator {
+public:
+    // Аккумулятор на время одного запроса: очищается при выходе, в том числе
+    // по исключению. Вложенный запрос (например, из предиката) получает
+    // временный экземпляр, чтобы не испортить уже занятый
+    class Lease {
+    public:
+        Lease(RelevanceAccumulator& shared, size_t size) {
+            if (shared.in_use_) {
+                nested_ = std::make_unique<RelevanceAccumulator>();
+                accumulator_ = nested_.get();
+            } else {
+                accumulator_ = &shared;
+            }
+            accumulator_->in_use_ = true;
+            accumulator_->Resize(size);
+        }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease() {
+            accumulator_->Clear();
+            accumulator_->in_use_ = false;
+        }
+
+        RelevanceAccumulator& operator*() const {
+            return *accumulator_;
+        }
+        RelevanceAccumulator* operator->() const {
+            return accumulator_;
+        }
+
+    private:
+        std::unique_ptr<RelevanceAccumulator> nested_;
+        RelevanceAccumulator* accumulator_ = nullptr;
+    };
+
+    // Вызывается только для очищенного аккумулятора
+    void Resize(size_t size) {
+        if (relevances_.size() < size) {
+            relevances_.resize(size);
+            states_.resize(size, UNTOUCHED);
+        }
+    }
+
+    void Add(size_t slot, double relevance) {
+        if (states_[slot] == UNTOUCHED) {
+            states_[slot] = SCORED;
+            relevances_[slot] = relevance;
+            touched_.push_back(static_cast<uint32_t>(slot));
+        } else if (states_[slot] == SCORED) {
+            relevances_[slot] += relevance;
+        }
+    }
+
+    // Документ с минус-словом выпадает из выдачи
+    void Exclude(size_t slot) {
+        if (states_[slot] == SCORED) {
+            states_[slot] = EXCLUDED;
+        }
+    }
+
+    template <typename Func>
+    void ForEachScored(Func func) const {
+        for (const uint32_t slot : touched_) {
+            if (states_[slot] == SCORED) {
+                func(slot, relevances_[slot]);
+            }
+        }
+    }
+
+    void Clear() {
+        for (const uint32_t slot : touched_) {
+            states_[slot] = UNTOUCHED;
+        }
+        touched_.clear();
+    }
+
+private:
+    enum State : uint8_t {
+        UNTOUCHED,
+        SCORED,
+        EXCLUDED,
+    };
+
+    std::vector<double> relevances_;
+    std::vector<State> states_;
+    std::vector<uint32_t> touched_;
+    bool in_use_ = false;
+};
@@ -0,0 +1,111 @@
+#include "result_cache.h"
+
+#include <functional>
+
+using namespace std;
+
+namespace {
+
+template <typename T>
+void AppendValue(string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// узлы списка и хеш-таблицы, управляющие блоки shared_ptr
+const size_t ENTRY_OVERHEAD_BYTES = 128;
+
+}  // namespace
+
+ResultCache::ResultCache(size_t max_memory_bytes, size_t shard_count)
+    : shard_memory_bytes_(max_memory_bytes / shard_count)
+    , shards_(shard_count) {
+}
+
+string ResultCache::MakeTextKey(string_view raw_query, uint32_t filter_tag, size_t top_k) {
+    string key;
+    key.reserve(1 + sizeof(filter_tag) + sizeof(top_k) + raw_query.size());
+    key.push_back('T');
+    AppendValue(key, filter_tag);
+    AppendValue(key, top_k);
+    key.append(raw_query);
+    return key;
+}
+
+string ResultCache::MakeTermsKey(const vector<TermId>& plus_terms, const vector<TermId>& minus_terms,
+                                 uint32_t filter_tag, size_t top_k) {
+    string key;
+    key.reserve(1 + sizeof(filter_tag) + sizeof(top_k) + sizeof(uint32_t)
+                + (plus_terms.size() + minus_terms.size()) * sizeof(TermId));
+    key.push_back('Q');
+    AppendValue(key, filter_tag);
+    AppendValue(key, top_k);
+    AppendValue(key, static_cast<uint32_t>(plus_terms.size()));
+    key.append(reinterpret_cast<const char*>(plus_terms.data()), plus_terms.size() * sizeof(TermId));
+    key.append(reinterpret_cast<const char*>(minus_terms.data()), minus_terms.size() * sizeof(TermId));
+    return key;
+}
+
+ResultCache::Shard& ResultCache::GetShard(const string& key) {
+    return shards_[hash<string>()(key) % shards_.size()];
+}
+
+void ResultCache::Shard::Erase(list<Entry>::iterator it) {
+    memory_bytes -= it->memory_bytes;
+    index.erase(it->key);
+    entries.erase(it);
+}
+
+ResultCache::Results ResultCache::Find(const string& key, uint64_t generation) {
+    Shard& shard = GetShard(key);
+    lock_guard lock(shard.mutex);
+    const auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        return nullptr;
+    }
+    if (it->second->generation != generation) {
+        shard.Erase(it->second);
+        return nullptr;
+    }
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    return it->second->results;
+}
+
+void ResultCache::Insert(string key, uint64_t generation, Results results) {
+    const size_t memory_bytes = ENTRY_OVERHEAD_BYTES + key.size() + results->size() * sizeof(Document);
+    if (memory_bytes > shard_memory_bytes_) {
+        return;
+    }
+    Shard& shard = GetShard(key);
+    lock_guard lock(shard.mutex);
+    const auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+        shard.Erase(it->second);
+    }
+    while (shard.memory_bytes + memory_bytes > shard_memory_bytes_) {
+        shard.Erase(prev(shard.entries.end()));
+    }
+    shard.entries.push_front({move(key), generation, move(results), memory_bytes});
+    shard.index.emplace(shard.entries.front().key, shard.entries.begin());
+    shard.memory_bytes += memory_bytes;
+}
+
+void ResultCache::Clear() {
+    for (Shard& shard : shards_) {
+        lock_guard lock(shard.mutex);
+        shard.index.clear();
+        shard.entries.clear();
+        shard.memory_bytes = 0;
+    }
+}
+
+ResultCacheStats ResultCache::GetStats() const {
+    ResultCacheStats stats;
+    stats.hits = hits_.load(memory_order_relaxed);
+    stats.misses = misses_.load(memory_order_relaxed);
+    for (const Shard& shard : shards_) {
+        lock_guard lock(shard.mutex);
+        stats.entry_count += shard.entries.size();
+        stats.memory_bytes += shard.memory_bytes;
+    }
+    return stats;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "document.h"
+#include "term_dictionary.h"
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct ResultCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    size_t entry_count = 0;
+    size_t memory_bytes = 0;
+};
+
+// Кэш результатов поиска: несколько независимых LRU-частей со своими
+// мьютексами, чтобы параллельные запросы не ждали друг друга. Память
+// ограничена суммарным размером записей. Запись хранит поколение индекса,
+// в котором посчитана; запись другого поколения считается отсутствующей
+class ResultCache {
+public:
+    using Results = std::shared_ptr<const std::vector<Document>>;
+
+    explicit ResultCache(size_t max_memory_bytes, size_t shard_count = 16);
+
+    // Ключ по тексту запроса: находится без разбора запроса
+    static std::string MakeTextKey(std::string_view raw_query, uint32_t filter_tag, size_t top_k);
+    // Ключ по разобранному запросу: отсортированные без повторов номера слов
+    static std::string MakeTermsKey(const std::vector<TermId>& plus_terms, const std::vector<TermId>& minus_terms,
+                                    uint32_t filter_tag, size_t top_k);
+
+    // nullptr, если записи нет или она из другого поколения
+    Results Find(const std::string& key, uint64_t generation);
+    void Insert(std::string key, uint64_t generation, Results results);
+    void Clear();
+
+    void CountHit() {
+        hits_.fetch_add(1, std::memory_order_relaxed);
+    }
+    void CountMiss() {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+    }
+    ResultCacheStats GetStats() const;
+
+private:
+    struct Entry {
+        std::string key;
+        uint64_t generation;
+        Results results;
+        size_t memory_bytes;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        // от недавно использованных к давно использованным
+        std::list<Entry> entries;
+        // ключи указывают в записи списка, узлы которого не перемещаются
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+        size_t memory_bytes = 0;
+
+        void Erase(std::list<Entry>::iterator it);
+    };
+
+    const size_t shard_memory_bytes_;
+    std::vector<Shard> shards_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+
+    Shard& GetShard(const std::string& key);
+};
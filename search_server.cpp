@@ -18,29 +18,372 @@ void SearchServer::AddDocument(int document_id, string_view document,
     if (document_id < 0) {
         throw std::invalid_argument("Negative ID"s);
     }
-    if (documents_.find(document_id) != documents_.end()) {
+    if (document_ordinals_.count(document_id) > 0) {
         throw std::invalid_argument("ID exists"s);
     }
-    if (!IsValidWord(document)) {
+    vector<string_view>& words = GetThreadWordBuffer();
+    if (!SplitIntoValidWords(document, words)) {
         throw std::invalid_argument("Text is invalid"s);
     }
+    if (log_) {
+        applied_lsn_ = log_->AppendAddDocument(document_id, document, status, ratings);
+        CommitLog();
+    }
 
-    auto words = SplitIntoWordsNoStop(document);
-    const std::string_view document_text{ document };
-    documents_.emplace(document_id, DocumentData{ SearchServer::ComputeAverageRating(ratings), status, document_text });
-    
-    words = SplitIntoWordsNoStop(documents_.at(document_id).doc_text);
+    Thaw();
+    ++generation_;
+
+    const int ordinal = static_cast<int>(document_ids_.size());
+    auto& word_freqs = document_to_word_freqs_.emplace_back();
 
-	const double inv_word_count = 1.0 / words.size();
+	vector<TermId> term_ids;
+	term_ids.reserve(words.size());
 	for (string_view word : words) {
-		all_words_.insert(static_cast<string>(word));
-		word_to_document_freqs_[*all_words_.find(static_cast<string>(word))][document_id] +=
-				inv_word_count;
-		document_to_word_freqs_[document_id][*all_words_.find(static_cast<string>(word))] +=
-				inv_word_count;
+		const TermId term_id = AddTerm(word);
+		if (!IsStopTerm(term_id)) {
+			term_ids.push_back(term_id);
+		}
 	}
-	documents_.emplace(document_id, DocumentData{ SearchServer::ComputeAverageRating(ratings), status, document_text });
-	id_list_.insert(document_id);
+	ComputeWordFreqs(term_ids, word_freqs);
+	for (const auto& [term_id, term_freq] : word_freqs) {
+		word_to_document_freqs_[term_id].postings[ordinal] = term_freq;
+	}
+	document_ordinals_.emplace(document_id, ordinal);
+	document_word_counts_.push_back(static_cast<int>(term_ids.size()));
+	document_ids_.push_back(document_id);
+	document_ratings_.push_back(ComputeAverageRating(ratings));
+	document_statuses_.push_back(status);
+}
+
+vector<exception_ptr> SearchServer::AddDocuments(const vector<DocumentInput>& documents) {
+    return AddDocumentsImpl(execution::seq, documents);
+}
+
+vector<exception_ptr> SearchServer::AddDocuments(execution::sequenced_policy policy,
+                                                 const vector<DocumentInput>& documents) {
+    return AddDocumentsImpl(policy, documents);
+}
+
+vector<exception_ptr> SearchServer::AddDocuments(execution::parallel_policy policy,
+                                                 const vector<DocumentInput>& documents) {
+    return AddDocumentsImpl(policy, documents);
+}
+
+template <typename ExecutionPolicy>
+vector<exception_ptr> SearchServer::AddDocumentsImpl(ExecutionPolicy policy, const vector<DocumentInput>& documents) {
+    vector<exception_ptr> errors(documents.size());
+
+    // 1. разбор текстов; словарь только читается, новые слова откладываются
+    struct ParsedDocument {
+        bool is_valid = false;
+        vector<TermId> term_ids;
+        // позиция в term_ids и слово, которого ещё нет в словаре
+        vector<pair<size_t, string_view>> new_words;
+    };
+    vector<ParsedDocument> parsed(documents.size());
+    vector<size_t> indexes(documents.size());
+    iota(indexes.begin(), indexes.end(), 0);
+    for_each(policy, indexes.begin(), indexes.end(), [&](size_t index) {
+        const DocumentInput& input = documents[index];
+        ParsedDocument& document = parsed[index];
+        vector<string_view>& words = GetThreadWordBuffer();
+        if (input.id < 0 || !SplitIntoValidWords(input.text, words)) {
+            return;
+        }
+        document.is_valid = true;
+        document.term_ids.reserve(words.size());
+        for (string_view word : words) {
+            const TermId term_id = dictionary_.Find(word);
+            if (term_id == TermDictionary::npos) {
+                document.new_words.emplace_back(document.term_ids.size(), word);
+            } else if (IsStopTerm(term_id)) {
+                continue;
+            }
+            document.term_ids.push_back(term_id);
+        }
+    });
+
+    // 2. по порядку пакета: ошибки как при поочерёдном AddDocument
+    vector<size_t> accepted;
+    unordered_set<int> accepted_ids;
+    for (size_t index = 0; index < documents.size(); ++index) {
+        const DocumentInput& input = documents[index];
+        if (input.id < 0) {
+            errors[index] = make_exception_ptr(invalid_argument("Negative ID"s));
+        } else if (document_ordinals_.count(input.id) > 0 || accepted_ids.count(input.id) > 0) {
+            errors[index] = make_exception_ptr(invalid_argument("ID exists"s));
+        } else if (!parsed[index].is_valid) {
+            errors[index] = make_exception_ptr(invalid_argument("Text is invalid"s));
+        } else {
+            accepted_ids.insert(input.id);
+            accepted.push_back(index);
+        }
+    }
+    if (accepted.empty()) {
+        return errors;
+    }
+    if (log_) {
+        for (const size_t index : accepted) {
+            const DocumentInput& input = documents[index];
+            applied_lsn_ = log_->AppendAddDocument(input.id, input.text, input.status, input.ratings);
+        }
+        CommitLog();
+    }
+
+    // номера документов и номера новых слов
+    const int first_ordinal = static_cast<int>(document_ids_.size());
+    for (size_t i = 0; i < accepted.size(); ++i) {
+        ParsedDocument& document = parsed[accepted[i]];
+        for (const auto& [position, word] : document.new_words) {
+            document.term_ids[position] = AddTerm(word);
+        }
+        document_ordinals_.emplace(documents[accepted[i]].id, first_ordinal + static_cast<int>(i));
+    }
+    Thaw();
+    ++generation_;
+
+    // 3. прямой индекс и свойства документов
+    const size_t ordinal_count = first_ordinal + accepted.size();
+    document_to_word_freqs_.resize(ordinal_count);
+    document_word_counts_.resize(ordinal_count);
+    document_ids_.resize(ordinal_count);
+    document_ratings_.resize(ordinal_count);
+    document_statuses_.resize(ordinal_count);
+    vector<size_t> batch_indexes(accepted.size());
+    iota(batch_indexes.begin(), batch_indexes.end(), 0);
+    for_each(policy, batch_indexes.begin(), batch_indexes.end(), [&](size_t batch_index) {
+        const size_t ordinal = first_ordinal + batch_index;
+        const DocumentInput& input = documents[accepted[batch_index]];
+        vector<TermId>& term_ids = parsed[accepted[batch_index]].term_ids;
+        document_word_counts_[ordinal] = static_cast<int>(term_ids.size());
+        ComputeWordFreqs(term_ids, document_to_word_freqs_[ordinal]);
+        vector<TermId>().swap(term_ids);
+        document_ids_[ordinal] = input.id;
+        document_ratings_[ordinal] = ComputeAverageRating(input.ratings);
+        document_statuses_[ordinal] = input.status;
+    });
+
+    // 4. частичные обратные индексы групп документов, затем слияние:
+    // каждое слово дописывает только один поток, номера документов растут
+    struct PartialPosting {
+        TermId term_id;
+        int ordinal;
+        double term_freq;
+    };
+    const size_t group_count = min(accepted.size(), static_cast<size_t>(4 * max(1u, thread::hardware_concurrency())));
+    const size_t group_size = (accepted.size() + group_count - 1) / group_count;
+    vector<vector<PartialPosting>> partial_indexes(group_count);
+    vector<size_t> groups(group_count);
+    iota(groups.begin(), groups.end(), 0);
+    for_each(policy, groups.begin(), groups.end(), [&](size_t group) {
+        vector<PartialPosting>& partial_index = partial_indexes[group];
+        const size_t last = min(accepted.size(), (group + 1) * group_size);
+        for (size_t batch_index = group * group_size; batch_index < last; ++batch_index) {
+            const int ordinal = first_ordinal + static_cast<int>(batch_index);
+            for (const auto& [term_id, term_freq] : document_to_word_freqs_[ordinal]) {
+                partial_index.push_back({term_id, ordinal, term_freq});
+            }
+        }
+        stable_sort(partial_index.begin(), partial_index.end(),
+                    [](const PartialPosting& lhs, const PartialPosting& rhs) {
+                        return lhs.term_id < rhs.term_id;
+                    });
+    });
+
+    const size_t term_count = dictionary_.size();
+    for_each(policy, groups.begin(), groups.end(), [&](size_t shard) {
+        const TermId first_term = static_cast<TermId>(term_count * shard / group_count);
+        const TermId last_term = static_cast<TermId>(term_count * (shard + 1) / group_count);
+        for (const vector<PartialPosting>& partial_index : partial_indexes) {
+            auto it = lower_bound(partial_index.begin(), partial_index.end(), first_term,
+                                  [](const PartialPosting& posting, TermId term_id) {
+                                      return posting.term_id < term_id;
+                                  });
+            for (; it != partial_index.end() && it->term_id < last_term; ++it) {
+                auto& postings = word_to_document_freqs_[it->term_id].postings;
+                postings.emplace_hint(postings.end(), it->ordinal, it->term_freq);
+            }
+        }
+    });
+    return errors;
+}
+
+void SearchServer::RemoveDocuments(const vector<int>& document_ids) {
+    RemoveDocumentsImpl(execution::seq, document_ids);
+}
+
+void SearchServer::RemoveDocuments(execution::sequenced_policy policy, const vector<int>& document_ids) {
+    RemoveDocumentsImpl(policy, document_ids);
+}
+
+void SearchServer::RemoveDocuments(execution::parallel_policy policy, const vector<int>& document_ids) {
+    RemoveDocumentsImpl(policy, document_ids);
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::RemoveDocumentsImpl(ExecutionPolicy policy, const vector<int>& document_ids) {
+    // 1. номера удаляемых документов
+    vector<int> ordinals;
+    ordinals.reserve(document_ids.size());
+    vector<int> removed_ids;
+    removed_ids.reserve(document_ids.size());
+    unordered_set<int> seen_ids;
+    for (const int document_id : document_ids) {
+        const auto it = document_ordinals_.find(document_id);
+        if (it == document_ordinals_.end() || !seen_ids.insert(document_id).second) {
+            continue;
+        }
+        ordinals.push_back(it->second);
+        removed_ids.push_back(document_id);
+    }
+    if (ordinals.empty()) {
+        return;
+    }
+    if (log_) {
+        for (const int document_id : removed_ids) {
+            applied_lsn_ = log_->AppendRemoveDocument(document_id);
+        }
+        CommitLog();
+    }
+    for (const int document_id : removed_ids) {
+        document_ordinals_.erase(document_id);
+    }
+    if (!CanRemoveWithoutThaw()) {
+        Thaw();
+    }
+    ++generation_;
+    if (is_frozen_) {
+        for (const int ordinal : ordinals) {
+            RemoveFrozenDocument(ordinal);
+        }
+        if (NeedsCompaction()) {
+            Compact(policy);
+        }
+        return;
+    }
+    sort(ordinals.begin(), ordinals.end());
+
+    // 2. пары (слово, документ) групп документов, упорядоченные по слову
+    struct RemovedPosting {
+        TermId term_id;
+        int ordinal;
+    };
+    const size_t group_count = min(ordinals.size(), static_cast<size_t>(4 * max(1u, thread::hardware_concurrency())));
+    const size_t group_size = (ordinals.size() + group_count - 1) / group_count;
+    vector<vector<RemovedPosting>> partial_indexes(group_count);
+    vector<size_t> groups(group_count);
+    iota(groups.begin(), groups.end(), 0);
+    for_each(policy, groups.begin(), groups.end(), [&](size_t group) {
+        vector<RemovedPosting>& partial_index = partial_indexes[group];
+        const size_t last = min(ordinals.size(), (group + 1) * group_size);
+        for (size_t i = group * group_size; i < last; ++i) {
+            for (const auto& [term_id, term_freq] : document_to_word_freqs_[ordinals[i]]) {
+                partial_index.push_back({term_id, ordinals[i]});
+            }
+        }
+        stable_sort(partial_index.begin(), partial_index.end(),
+                    [](const RemovedPosting& lhs, const RemovedPosting& rhs) {
+                        return lhs.term_id < rhs.term_id;
+                    });
+    });
+
+    // 3. списки слов чистятся по диапазонам номеров слов: каждое слово
+    // меняет только один поток
+    const size_t term_count = dictionary_.size();
+    for_each(policy, groups.begin(), groups.end(), [&](size_t shard) {
+        const TermId first_term = static_cast<TermId>(term_count * shard / group_count);
+        const TermId last_term = static_cast<TermId>(term_count * (shard + 1) / group_count);
+        for (const vector<RemovedPosting>& partial_index : partial_indexes) {
+            auto it = lower_bound(partial_index.begin(), partial_index.end(), first_term,
+                                  [](const RemovedPosting& posting, TermId term_id) {
+                                      return posting.term_id < term_id;
+                                  });
+            for (; it != partial_index.end() && it->term_id < last_term; ++it) {
+                word_to_document_freqs_[it->term_id].postings.erase(it->ordinal);
+            }
+        }
+    });
+
+    // освобождаем прямой индекс; номера документов больше не используются
+    for_each(policy, ordinals.begin(), ordinals.end(), [this](int ordinal) {
+        vector<pair<TermId, double>>().swap(document_to_word_freqs_[ordinal]);
+    });
+
+    if (NeedsCompaction()) {
+        Compact(policy);
+    }
+}
+
+void SearchServer::UpdateDocument(int document_id, string_view document, DocumentStatus status,
+                                  const vector<int>& ratings) {
+    const int ordinal = GetOrdinal(document_id);
+    vector<string_view>& words = GetThreadWordBuffer();
+    if (!SplitIntoValidWords(document, words)) {
+        throw std::invalid_argument("Text is invalid"s);
+    }
+    if (log_) {
+        applied_lsn_ = log_->AppendUpdateDocument(document_id, document, status, ratings);
+        CommitLog();
+    }
+
+    Thaw();
+    ++generation_;
+
+    vector<TermId> term_ids;
+    term_ids.reserve(words.size());
+    for (string_view word : words) {
+        const TermId term_id = AddTerm(word);
+        if (!IsStopTerm(term_id)) {
+            term_ids.push_back(term_id);
+        }
+    }
+    vector<pair<TermId, double>> word_freqs;
+    ComputeWordFreqs(term_ids, word_freqs);
+
+    // оба прямых индекса отсортированы по номеру слова: слияние находит
+    // пропавшие, новые и изменившие частоту слова
+    const auto& old_word_freqs = document_to_word_freqs_[ordinal];
+    auto old_it = old_word_freqs.begin();
+    auto new_it = word_freqs.begin();
+    while (old_it != old_word_freqs.end() || new_it != word_freqs.end()) {
+        if (new_it == word_freqs.end() || (old_it != old_word_freqs.end() && old_it->first < new_it->first)) {
+            word_to_document_freqs_[old_it->first].postings.erase(ordinal);
+            ++old_it;
+        } else if (old_it == old_word_freqs.end() || new_it->first < old_it->first) {
+            word_to_document_freqs_[new_it->first].postings.emplace(ordinal, new_it->second);
+            ++new_it;
+        } else {
+            if (old_it->second != new_it->second) {
+                word_to_document_freqs_[new_it->first].postings[ordinal] = new_it->second;
+            }
+            ++old_it;
+            ++new_it;
+        }
+    }
+    document_to_word_freqs_[ordinal] = move(word_freqs);
+    document_word_counts_[ordinal] = static_cast<int>(term_ids.size());
+    document_ratings_[ordinal] = ComputeAverageRating(ratings);
+    document_statuses_[ordinal] = status;
+}
+
+void SearchServer::SetStatus(int document_id, DocumentStatus status) {
+    const int ordinal = GetOrdinal(document_id);
+    if (log_) {
+        applied_lsn_ = log_->AppendSetStatus(document_id, status);
+        CommitLog();
+    }
+    ++attribute_generation_;
+    document_statuses_[ordinal] = status;
+}
+
+void SearchServer::SetRating(int document_id, const vector<int>& ratings) {
+    const int ordinal = GetOrdinal(document_id);
+    if (log_) {
+        applied_lsn_ = log_->AppendSetRating(document_id, ratings);
+        CommitLog();
+    }
+    ++attribute_generation_;
+    document_ratings_[ordinal] = ComputeAverageRating(ratings);
 }
 
 using MatchResult = std::tuple<std::vector<std::string_view>, DocumentStatus>;
@@ -53,9 +396,7 @@ MatchResult SearchServer::MatchDocument(string_view raw_query,
 MatchResult SearchServer::MatchDocument(const execution::sequenced_policy,
                                                                                       string_view raw_query,
                                                                                       int document_id) const {
-    if (documents_.count(document_id) == 0) {
-        throw out_of_range("Invalid id");
-    }
+    const int ordinal = GetOrdinal(document_id);
  
     if (raw_query.empty()) {
         throw invalid_argument("Invalid query");
@@ -63,62 +404,55 @@ MatchResult SearchServer::MatchDocument(const execution::sequenced_policy,
  
     const auto result = ParseQueryForSeq(raw_query);
     vector<string_view> matched_words;
-    for (auto word : result.minus_words) {
- 
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            return {vector<basic_string_view<char>>{}, documents_.at(document_id).status};
- 
+    for (const TermId term_id : result.minus_terms) {
+        if (FindPostings(term_id).contains(ordinal)) {
+            return {vector<basic_string_view<char>>{}, document_statuses_[ordinal]};
         }
     }
-    for (auto word : result.plus_words) {
- 
-        if (word_to_document_freqs_.count(word) == 0) {
- 
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.push_back(word);
+    for (const TermId term_id : result.plus_terms) {
+        if (FindPostings(term_id).contains(ordinal)) {
+            matched_words.push_back(dictionary_.GetTerm(term_id));
         }
- 
     }
-    return {matched_words, documents_.at(document_id).status};
+    sort(matched_words.begin(), matched_words.end());
+    return {matched_words, document_statuses_[ordinal]};
 }
  
 MatchResult SearchServer::MatchDocument(const execution::parallel_policy,
                                                                                       string_view raw_query,
                                                                                       int document_id) const {
-    if (documents_.count(document_id) == 0) {
-        throw out_of_range("Invalid id");
-    }
+    const int ordinal = GetOrdinal(document_id);
 
     if (raw_query.empty()) {
         throw invalid_argument("Invalid query");
     }
     const auto& result = ParseQuery(raw_query);
  
-    const auto& check = [this, document_id](string_view word) {
-        const auto help = word_to_document_freqs_.find(word);
-        return help!= word_to_document_freqs_.end() &&
-               help->second.count(document_id);
+    const auto& check = [this, ordinal](TermId term_id) {
+        return FindPostings(term_id).contains(ordinal);
     };
  
     if (any_of(execution::par,
-                    result.minus_words.begin(),
-                    result.minus_words.end(),
+                    result.minus_terms.begin(),
+                    result.minus_terms.end(),
                     check)) {
-        return {vector<basic_string_view<char>>{}, documents_.at(document_id).status};
+        return {vector<basic_string_view<char>>{}, document_statuses_[ordinal]};
     }
  
-    vector<string_view> matched_words(result.plus_words.size());
+    vector<TermId> matched_terms(result.plus_terms.size());
  
-    auto end = copy_if(execution::par,
-                            result.plus_words.begin(),
-                            result.plus_words.end(),
-                            matched_words.begin(),
+    const auto matched_end = copy_if(execution::par,
+                            result.plus_terms.begin(),
+                            result.plus_terms.end(),
+                            matched_terms.begin(),
                             check);
+
+    vector<string_view> matched_words(matched_end - matched_terms.begin());
+    transform(matched_terms.begin(), matched_end, matched_words.begin(),
+              [this](TermId term_id) {
+                  return dictionary_.GetTerm(term_id);
+              });
+    auto end = matched_words.end();
  
     sort(matched_words.begin(), end);
     end = unique(execution::par,
@@ -127,45 +461,674 @@ MatchResult SearchServer::MatchDocument(const execution::parallel_policy,
  
     matched_words.erase(end, matched_words.end());
     return {matched_words,
-            documents_.at(document_id).status};
+            document_statuses_[ordinal]};
+}
+
+
+vector<Document> SearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status,
+                                                size_t top_k) const {
+    return FindTopDocuments(std::execution::seq, raw_query, status, top_k);
 }
 
+vector<vector<Document>> SearchServer::FindTopDocumentsBatch(const vector<string_view>& raw_queries,
+                                                             DocumentStatus status, size_t top_k) const {
+    // кэш хранит результаты отдельных запросов
+    if (result_cache_) {
+        vector<vector<Document>> results;
+        results.reserve(raw_queries.size());
+        for (const string_view raw_query : raw_queries) {
+            results.push_back(FindTopDocuments(raw_query, status, top_k));
+        }
+        return results;
+    }
+    return FindTopDocumentsBatch(raw_queries,
+        [status](int, DocumentStatus document_status, int) {
+            return document_status == status;
+        },
+        top_k);
+}
 
-vector<Document> SearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(std::execution::seq, raw_query, status);
+void SearchServer::FindTopDocumentsBatch(const vector<string_view>& raw_queries, DocumentStatus status,
+                                         size_t top_k, vector<Document>& documents, vector<size_t>& offsets) const {
+    auto document_predicate = [status](int, DocumentStatus document_status, int) {
+        return document_status == status;
+    };
+    if (result_cache_) {
+        for (const string_view raw_query : raw_queries) {
+            const ResultCache::Results results = FindCachedResults(execution::seq, raw_query,
+                                                                   static_cast<uint32_t>(status), document_predicate,
+                                                                   top_k);
+            documents.insert(documents.end(), results->begin(), results->end());
+            offsets.push_back(documents.size());
+        }
+        return;
+    }
+    RankQueries(raw_queries, status, top_k, [&documents, &offsets](size_t, TopDocuments& top) {
+        top.AppendTo(documents);
+        offsets.push_back(documents.size());
+    });
+}
+
+void SearchServer::FindTopDocumentsBatch(const vector<string_view>& raw_queries, DocumentStatus status,
+                                         size_t top_k, Document* documents, const size_t* offsets) const {
+    auto document_predicate = [status](int, DocumentStatus document_status, int) {
+        return document_status == status;
+    };
+    // часть буфера меньше выдачи - ошибка вызывающего, запись за её край недопустима
+    const auto check_size = [offsets](size_t query_index, size_t size) {
+        if (offsets[query_index + 1] - offsets[query_index] != size) {
+            throw invalid_argument("Result slice does not match the result size"s);
+        }
+    };
+    if (result_cache_) {
+        for (size_t i = 0; i < raw_queries.size(); ++i) {
+            const ResultCache::Results results = FindCachedResults(execution::seq, raw_queries[i],
+                                                                   static_cast<uint32_t>(status), document_predicate,
+                                                                   top_k);
+            check_size(i, results->size());
+            copy(results->begin(), results->end(), documents + offsets[i]);
+        }
+        return;
+    }
+    RankQueries(raw_queries, status, top_k, [documents, offsets, &check_size](size_t query_index, TopDocuments& top) {
+        check_size(query_index, top.GetSize());
+        top.MoveTo(documents + offsets[query_index]);
+    });
+}
+
+template <typename ResultWriter>
+void SearchServer::RankQueries(const vector<string_view>& raw_queries, DocumentStatus status, size_t top_k,
+                               ResultWriter write_result) const {
+    auto document_predicate = [status](int, DocumentStatus document_status, int) {
+        return document_status == status;
+    };
+    vector<Query> queries;
+    queries.reserve(raw_queries.size());
+    for (const string_view raw_query : raw_queries) {
+        queries.push_back(ParseQueryForSeq(raw_query));
+    }
+    // одиночный запрос и отсечение не выигрывают от общего обхода
+    if (queries.size() == 1 || (is_frozen_ && dynamic_pruning_)) {
+        vector<TopDocuments>& tops = GetThreadBatchTops();
+        if (tops.empty()) {
+            tops.emplace_back(top_k);
+        }
+        for (size_t i = 0; i < queries.size(); ++i) {
+            tops.front().Reset(top_k);
+            const ResolvedQuery resolved_query = ResolveQuery(queries[i]);
+            if (!resolved_query.plus_postings.empty()) {
+                RankRange(resolved_query, document_predicate, 0, static_cast<int>(document_ids_.size()), tops.front());
+            }
+            write_result(i, tops.front());
+        }
+        return;
+    }
+    for (size_t first = 0; first < queries.size(); first += MAX_BATCH_QUERY_COUNT) {
+        const size_t query_count = min(MAX_BATCH_QUERY_COUNT, queries.size() - first);
+        RankBatch(queries.data() + first, query_count, document_predicate, top_k,
+                  [&write_result, first](size_t query_index, TopDocuments& top) {
+                      write_result(first + query_index, top);
+                  });
+    }
+}
+
+size_t SearchServer::CountTopDocuments(string_view raw_query, DocumentStatus status, size_t top_k) const {
+    const ResolvedQuery query = ResolveQuery(ParseQueryForSeq(raw_query));
+    // документы перебираются диапазонами номеров: обход кончается на
+    // диапазоне, где набралось top_k документов
+    const int ordinal_count = static_cast<int>(document_ids_.size());
+    const int range_size = 1 << 12;
+    vector<int> ordinals;
+    size_t count = 0;
+    for (int first = 0; first < ordinal_count && count < top_k && !query.plus_postings.empty(); first += range_size) {
+        const int last = first + min(range_size, ordinal_count - first);
+        ordinals.clear();
+        for (const auto& [postings, inverse_document_freq] : query.plus_postings) {
+            postings.ForEachInRange(first, last, [&ordinals](int ordinal, double) {
+                ordinals.push_back(ordinal);
+            });
+        }
+        sort(ordinals.begin(), ordinals.end());
+        ordinals.erase(unique(ordinals.begin(), ordinals.end()), ordinals.end());
+        for (const int ordinal : ordinals) {
+            if (query.deleted_documents.Contains(ordinal) || IsRemoved(ordinal)
+                    || document_statuses_[ordinal] != status
+                    || any_of(query.minus_postings.begin(), query.minus_postings.end(),
+                              [ordinal](const WordPostings& postings) {
+                                  return postings.contains(ordinal);
+                              })) {
+                continue;
+            }
+            if (++count == top_k) {
+                break;
+            }
+        }
+    }
+    return count;
 }
 
 int SearchServer::GetDocumentCount() const {
-    return documents_.size();
+    return document_ordinals_.size();
 }
 
-const map<string_view, double>& SearchServer::GetWordFrequencies(int document_id) const{
-    auto it = document_to_word_freqs_.find(document_id);
-    if(it == document_to_word_freqs_.end()){
-        static map<string_view, double> word_freqs_empty;
-        return word_freqs_empty;
+map<string_view, double> SearchServer::GetWordFrequencies(int document_id) const{
+    map<string_view, double> word_freqs;
+    auto it = document_ordinals_.find(document_id);
+    if(it == document_ordinals_.end()){
+        return word_freqs;
     }
 
-    return it->second;
+    ForEachWordFreq(it->second, [this, &word_freqs](TermId term_id, double term_freq) {
+        word_freqs.emplace(dictionary_.GetTerm(term_id), term_freq);
+    });
+    return word_freqs;
 }
 
-set<int>::const_iterator SearchServer::begin() const {
-    return id_list_.begin();
+template <typename Func>
+void SearchServer::ForEachWordFreq(int ordinal, Func func) const {
+    if (snapshot_forward_index_.offsets.empty()) {
+        for (const auto& [term_id, term_freq] : document_to_word_freqs_[ordinal]) {
+            func(term_id, term_freq);
+        }
+        return;
+    }
+    const SnapshotForwardIndex& forward_index = snapshot_forward_index_;
+    for (size_t i = forward_index.offsets[ordinal]; i < forward_index.offsets[ordinal + 1]; ++i) {
+        func(forward_index.term_ids[i], forward_index.term_freqs[i]);
+    }
 }
 
-set<int>::const_iterator SearchServer::end() const {
-    return id_list_.end();
+void SearchServer::Freeze(PostingFormat format, ImpactPrecision precision) {
+    if (is_frozen_ && frozen_index_.GetFormat() == format && frozen_index_.GetImpactPrecision() == precision) {
+        return;
+    }
+    Thaw();
+    frozen_index_ = BuildFrozenIndex(format, precision);
+    // с квантованными весами релевантность другая
+    if (result_cache_) {
+        result_cache_->Clear();
+    }
+    // удалённых документов в замороженном индексе нет
+    for (WordData& word_data : word_to_document_freqs_) {
+        map<int, double>().swap(word_data.postings);
+        word_data.removed_count = 0;
+    }
+    for (size_t ordinal = 0; ordinal < document_tombstones_.size(); ++ordinal) {
+        if (document_tombstones_[ordinal]) {
+            vector<pair<TermId, double>>().swap(document_to_word_freqs_[ordinal]);
+        }
+    }
+    is_frozen_ = true;
+}
+
+bool SearchServer::CanRemoveWithoutThaw() const {
+    return is_frozen_ && frozen_index_.GetImpactPrecision() == ImpactPrecision::EXACT;
 }
 
+// Прямой индекс документа остаётся: по нему снимок восстанавливает счётчики
+// удалённых документов слов
+void SearchServer::RemoveFrozenDocument(int ordinal) {
+    ForEachWordFreq(ordinal, [this](TermId term_id, double) {
+        ++word_to_document_freqs_[term_id].removed_count;
+    });
+    if (document_tombstones_.size() <= static_cast<size_t>(ordinal)) {
+        document_tombstones_.resize(document_ids_.size());
+    }
+    document_tombstones_[ordinal] = true;
+}
 
-vector<string_view> SearchServer::SplitIntoWordsNoStop(const string_view text) const {
-    vector<string_view> words;
-    for (const auto word : SplitIntoWords(text)) {
-        if (!IsStopWord(word)) {
-            words.push_back(word);
+FrozenIndex SearchServer::BuildFrozenIndex(PostingFormat format, ImpactPrecision precision) const {
+    size_t posting_count = 0;
+    for (const WordData& word_data : word_to_document_freqs_) {
+        posting_count += word_data.postings.size() - word_data.removed_count;
+    }
+    FrozenIndex frozen_index(format, document_word_counts_);
+    frozen_index.Reserve(word_to_document_freqs_.size(), posting_count);
+    // пустые списки тоже сохраняются, чтобы номер слова в индексе совпадал с TermId
+    map<int, double> live_postings;
+    for (const WordData& word_data : word_to_document_freqs_) {
+        const map<int, double>* postings = &word_data.postings;
+        if (word_data.removed_count > 0) {
+            live_postings.clear();
+            for (const auto [ordinal, term_freq] : word_data.postings) {
+                if (!IsRemoved(ordinal)) {
+                    live_postings.emplace_hint(live_postings.end(), ordinal, term_freq);
+                }
+            }
+            postings = &live_postings;
         }
+        const size_t document_freq = postings->size();
+        frozen_index.AddWord(*postings, document_freq > 0 ? ComputeInverseDocumentFreq(document_freq) : 0.0);
     }
-    return words;
+    frozen_index.QuantizeImpacts(precision);
+    return frozen_index;
+}
+
+bool SearchServer::IsFrozen() const {
+    return is_frozen_;
+}
+
+void SearchServer::SetDynamicPruning(bool enabled) {
+    dynamic_pruning_ = enabled;
+}
+
+void SearchServer::EnableResultCache(size_t max_memory_bytes) {
+    result_cache_ = max_memory_bytes > 0 ? make_unique<ResultCache>(max_memory_bytes) : nullptr;
+}
+
+ResultCacheStats SearchServer::GetResultCacheStats() const {
+    return result_cache_ ? result_cache_->GetStats() : ResultCacheStats{};
+}
+
+void SearchServer::Thaw() {
+    if (!is_frozen_) {
+        return;
+    }
+    for (size_t word_index = 0; word_index < frozen_index_.GetWordCount(); ++word_index) {
+        auto& postings = word_to_document_freqs_[word_index].postings;
+        frozen_index_.ForEachPosting(word_index, [&postings](int ordinal, double term_freq) {
+            postings.emplace_hint(postings.end(), ordinal, term_freq);
+        });
+    }
+    frozen_index_ = FrozenIndex();
+    is_frozen_ = false;
+
+    if (!snapshot_forward_index_.offsets.empty()) {
+        document_to_word_freqs_.resize(document_ids_.size());
+        for (int ordinal = 0; ordinal < static_cast<int>(document_ids_.size()); ++ordinal) {
+            ForEachWordFreq(ordinal, [this, ordinal](TermId term_id, double term_freq) {
+                document_to_word_freqs_[ordinal].emplace_back(term_id, term_freq);
+            });
+        }
+        snapshot_forward_index_ = {};
+    }
+    // данные снимка больше не используются
+    snapshot_file_.reset();
+}
+
+void SearchServer::SaveSnapshot(const string& path) const {
+    SnapshotWriter writer(path);
+    writer.WriteValue(applied_lsn_);
+
+    // словарь: стоп-слова, затем остальные слова в порядке номеров
+    writer.WriteValue(stop_term_count_);
+    size_t term_offset = 0;
+    writer.BeginArray<size_t>(dictionary_.size() + 1);
+    writer.Append(&term_offset, 1);
+    for (TermId term_id = 0; term_id < dictionary_.size(); ++term_id) {
+        term_offset += dictionary_.GetTerm(term_id).size();
+        writer.Append(&term_offset, 1);
+    }
+    writer.EndArray();
+    writer.BeginArray<char>(term_offset);
+    for (TermId term_id = 0; term_id < dictionary_.size(); ++term_id) {
+        const string_view term = dictionary_.GetTerm(term_id);
+        writer.Append(term.data(), term.size());
+    }
+    writer.EndArray();
+
+    // свойства документов по номерам и действующие документы по возрастанию id
+    writer.WriteArray(document_ids_);
+    writer.WriteArray(document_ratings_);
+    writer.WriteArray(document_statuses_);
+    writer.WriteArray(document_word_counts_);
+    writer.BeginArray<int>(document_ordinals_.size());
+    for (const auto& [document_id, ordinal] : document_ordinals_) {
+        writer.Append(&document_id, 1);
+    }
+    writer.EndArray();
+    writer.BeginArray<int>(document_ordinals_.size());
+    for (const auto& [document_id, ordinal] : document_ordinals_) {
+        writer.Append(&ordinal, 1);
+    }
+    writer.EndArray();
+
+    // прямой индекс в формате CSR
+    const int ordinal_count = static_cast<int>(document_ids_.size());
+    size_t forward_offset = 0;
+    writer.BeginArray<size_t>(ordinal_count + 1);
+    writer.Append(&forward_offset, 1);
+    for (int ordinal = 0; ordinal < ordinal_count; ++ordinal) {
+        ForEachWordFreq(ordinal, [&forward_offset](TermId, double) {
+            ++forward_offset;
+        });
+        writer.Append(&forward_offset, 1);
+    }
+    writer.EndArray();
+    writer.BeginArray<TermId>(forward_offset);
+    for (int ordinal = 0; ordinal < ordinal_count; ++ordinal) {
+        ForEachWordFreq(ordinal, [&writer](TermId term_id, double) {
+            writer.Append(&term_id, 1);
+        });
+    }
+    writer.EndArray();
+    writer.BeginArray<double>(forward_offset);
+    for (int ordinal = 0; ordinal < ordinal_count; ++ordinal) {
+        ForEachWordFreq(ordinal, [&writer](TermId, double term_freq) {
+            writer.Append(&term_freq, 1);
+        });
+    }
+    writer.EndArray();
+
+    // обратный индекс; изменяемый сохраняется в замороженном виде
+    if (is_frozen_) {
+        frozen_index_.Save(writer);
+    } else {
+        BuildFrozenIndex(PostingFormat::PLAIN, ImpactPrecision::EXACT).Save(writer);
+    }
+    writer.Finish();
+}
+
+SearchServer SearchServer::LoadSnapshot(const string& path) {
+    auto file = make_shared<const MappedFile>(path);
+    SnapshotReader reader(*file);
+    const auto applied_lsn = reader.ReadValue<uint64_t>();
+
+    const auto stop_term_count = reader.ReadValue<TermId>();
+    const FrozenArray<size_t> term_offsets = reader.ReadArray<size_t>();
+    const FrozenArray<char> term_chars = reader.ReadArray<char>();
+    SnapshotReader::Check(term_offsets.size() > stop_term_count && term_offsets[0] == 0
+                          && term_offsets.back() == term_chars.size());
+    const auto get_term = [&](TermId term_id) {
+        SnapshotReader::Check(term_offsets[term_id] <= term_offsets[term_id + 1]);
+        return string_view(term_chars.data() + term_offsets[term_id], term_offsets[term_id + 1] - term_offsets[term_id]);
+    };
+    vector<string_view> stop_words;
+    for (TermId term_id = 0; term_id < stop_term_count; ++term_id) {
+        stop_words.push_back(get_term(term_id));
+    }
+    SearchServer server(stop_words);
+    SnapshotReader::Check(server.stop_term_count_ == stop_term_count);
+    for (TermId term_id = stop_term_count; term_id + 1 < term_offsets.size(); ++term_id) {
+        SnapshotReader::Check(server.AddTerm(get_term(term_id)) == term_id);
+    }
+
+    server.document_ids_ = reader.ReadVector<int>();
+    server.document_ratings_ = reader.ReadVector<int>();
+    server.document_statuses_ = reader.ReadVector<DocumentStatus>();
+    server.document_word_counts_ = reader.ReadVector<int>();
+    const size_t ordinal_count = server.document_ids_.size();
+    SnapshotReader::Check(server.document_ratings_.size() == ordinal_count
+                          && server.document_statuses_.size() == ordinal_count
+                          && server.document_word_counts_.size() == ordinal_count);
+    const FrozenArray<int> live_ids = reader.ReadArray<int>();
+    const FrozenArray<int> live_ordinals = reader.ReadArray<int>();
+    SnapshotReader::Check(live_ids.size() == live_ordinals.size());
+    for (size_t i = 0; i < live_ids.size(); ++i) {
+        SnapshotReader::Check((i == 0 || live_ids[i - 1] < live_ids[i])
+                              && live_ordinals[i] >= 0 && static_cast<size_t>(live_ordinals[i]) < ordinal_count);
+        server.document_ordinals_.emplace_hint(server.document_ordinals_.end(), live_ids[i], live_ordinals[i]);
+    }
+
+    SnapshotForwardIndex& forward_index = server.snapshot_forward_index_;
+    forward_index.offsets = reader.ReadArray<size_t>();
+    forward_index.term_ids = reader.ReadArray<TermId>();
+    forward_index.term_freqs = reader.ReadArray<double>();
+    SnapshotReader::Check(forward_index.offsets.size() == ordinal_count + 1 && forward_index.offsets[0] == 0
+                          && forward_index.offsets.back() == forward_index.term_ids.size()
+                          && forward_index.term_ids.size() == forward_index.term_freqs.size());
+    for (size_t ordinal = 0; ordinal < ordinal_count; ++ordinal) {
+        SnapshotReader::Check(forward_index.offsets[ordinal] <= forward_index.offsets[ordinal + 1]);
+    }
+    for (const TermId term_id : forward_index.term_ids) {
+        SnapshotReader::Check(term_id < server.dictionary_.size());
+    }
+
+    server.frozen_index_ = FrozenIndex::Load(reader);
+    SnapshotReader::Check(server.frozen_index_.GetWordCount() == server.dictionary_.size());
+    server.is_frozen_ = true;
+
+    // документы, удалённые из замороженного индекса, остаются в его списках
+    server.document_tombstones_.assign(ordinal_count, true);
+    for (const int ordinal : live_ordinals) {
+        server.document_tombstones_[ordinal] = false;
+    }
+    for (size_t ordinal = 0; ordinal < ordinal_count; ++ordinal) {
+        if (server.document_tombstones_[ordinal]) {
+            server.ForEachWordFreq(ordinal, [&server, ordinal](TermId term_id, double) {
+                if (server.frozen_index_.Contains(term_id, static_cast<int>(ordinal))) {
+                    ++server.word_to_document_freqs_[term_id].removed_count;
+                }
+            });
+        }
+    }
+    server.snapshot_file_ = move(file);
+    server.applied_lsn_ = applied_lsn;
+    return server;
+}
+
+SearchServer::WordPostings SearchServer::FindPostings(TermId term_id) const {
+    if (is_frozen_) {
+        return WordPostings(&frozen_index_, term_id, &word_to_document_freqs_[term_id]);
+    }
+    return WordPostings(&word_to_document_freqs_[term_id]);
+}
+
+size_t SearchServer::WordPostings::size() const {
+    if (frozen_index_) {
+        return frozen_index_->GetDocumentCount(word_index_) - word_data_->removed_count;
+    }
+    return word_data_ ? word_data_->postings.size() - word_data_->removed_count : 0;
+}
+
+bool SearchServer::WordPostings::contains(int ordinal) const {
+    if (frozen_index_) {
+        return frozen_index_->Contains(word_index_, ordinal);
+    }
+    return word_data_ && word_data_->postings.count(ordinal) > 0;
+}
+
+SearchServer::DocumentIdIterator SearchServer::begin() const {
+    return DocumentIdIterator(document_ordinals_.begin());
+}
+
+SearchServer::DocumentIdIterator SearchServer::end() const {
+    return DocumentIdIterator(document_ordinals_.end());
+}
+
+void SearchServer::AttachLog(shared_ptr<WriteAheadLog> log, LogCommitMode commit_mode) {
+    // журнал старше снимка: все его записи уже в индексе
+    if (log->GetLastLsn() < applied_lsn_) {
+        log->Truncate(applied_lsn_);
+    }
+    log_.reset();
+    log->ForEachRecord(applied_lsn_, [this](const LogRecord& record) {
+        switch (record.type) {
+        case LogRecordType::ADD_DOCUMENT:
+            AddDocument(record.document_id, record.text, record.status, record.ratings);
+            break;
+        case LogRecordType::REMOVE_DOCUMENT:
+            RemoveDocument(record.document_id);
+            break;
+        case LogRecordType::UPDATE_DOCUMENT:
+            UpdateDocument(record.document_id, record.text, record.status, record.ratings);
+            break;
+        case LogRecordType::SET_STATUS:
+            SetStatus(record.document_id, record.status);
+            break;
+        case LogRecordType::SET_RATING:
+            SetRating(record.document_id, record.ratings);
+            break;
+        }
+        applied_lsn_ = record.lsn;
+    });
+    log_ = move(log);
+    log_commit_mode_ = commit_mode;
+}
+
+uint64_t SearchServer::GetAppliedLsn() const {
+    return applied_lsn_;
+}
+
+void SearchServer::CommitLog() {
+    if (log_commit_mode_ == LogCommitMode::EACH_CHANGE) {
+        log_->Commit(applied_lsn_);
+    }
+}
+
+void SearchServer::Checkpoint(const string& snapshot_path) {
+    SaveSnapshot(snapshot_path);
+    if (log_) {
+        log_->Truncate(applied_lsn_);
+    }
+}
+
+void SearchServer::LogRemoveDocument(int document_id) {
+    if (log_) {
+        applied_lsn_ = log_->AppendRemoveDocument(document_id);
+        CommitLog();
+    }
+}
+
+void SearchServer::ImportDocuments(const SearchServer& other, const unordered_set<int>& excluded_ids) {
+    Thaw();
+    ++generation_;
+    vector<TermId> term_ids(other.dictionary_.size(), TermDictionary::npos);
+    for (int other_ordinal = 0; other_ordinal < static_cast<int>(other.document_ids_.size()); ++other_ordinal) {
+        const int document_id = other.document_ids_[other_ordinal];
+        const auto it = other.document_ordinals_.find(document_id);
+        if (it == other.document_ordinals_.end() || it->second != other_ordinal
+                || excluded_ids.count(document_id) > 0 || document_ordinals_.count(document_id) > 0) {
+            continue;
+        }
+        const int ordinal = static_cast<int>(document_ids_.size());
+        auto& word_freqs = document_to_word_freqs_.emplace_back();
+        other.ForEachWordFreq(other_ordinal, [&](TermId other_term_id, double term_freq) {
+            TermId& term_id = term_ids[other_term_id];
+            if (term_id == TermDictionary::npos) {
+                term_id = AddTerm(other.dictionary_.GetTerm(other_term_id));
+            }
+            word_freqs.emplace_back(term_id, term_freq);
+        });
+        sort(word_freqs.begin(), word_freqs.end());
+        for (const auto& [term_id, term_freq] : word_freqs) {
+            auto& postings = word_to_document_freqs_[term_id].postings;
+            postings.emplace_hint(postings.end(), ordinal, term_freq);
+        }
+        document_ordinals_.emplace(document_id, ordinal);
+        document_word_counts_.push_back(other.document_word_counts_[other_ordinal]);
+        document_ids_.push_back(document_id);
+        document_ratings_.push_back(other.document_ratings_[other_ordinal]);
+        document_statuses_.push_back(other.document_statuses_[other_ordinal]);
+    }
+}
+
+void SearchServer::Compact() {
+    CompactImpl(execution::seq);
+}
+
+void SearchServer::Compact(execution::sequenced_policy policy) {
+    CompactImpl(policy);
+}
+
+void SearchServer::Compact(execution::parallel_policy policy) {
+    CompactImpl(policy);
+}
+
+bool SearchServer::NeedsCompaction() const {
+    return document_ids_.size() > 2 * document_ordinals_.size();
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::CompactImpl(ExecutionPolicy policy) {
+    const bool was_frozen = is_frozen_;
+    const PostingFormat format = frozen_index_.GetFormat();
+    const ImpactPrecision precision = frozen_index_.GetImpactPrecision();
+    Thaw();
+    ++generation_;
+
+    // действующие документы получают номера подряд в прежнем порядке
+    const int ordinal_count = static_cast<int>(document_ids_.size());
+    vector<int> new_ordinals(ordinal_count, -1);
+    for (const auto& [document_id, ordinal] : document_ordinals_) {
+        new_ordinals[ordinal] = 0;
+    }
+    vector<int> live_ordinals;
+    live_ordinals.reserve(document_ordinals_.size());
+    for (int ordinal = 0; ordinal < ordinal_count; ++ordinal) {
+        if (new_ordinals[ordinal] == 0) {
+            new_ordinals[ordinal] = static_cast<int>(live_ordinals.size());
+            live_ordinals.push_back(ordinal);
+        }
+    }
+
+    // остаются стоп-слова и слова с действующими документами, тоже в прежнем
+    // порядке: прямой индекс остаётся отсортированным по номеру слова
+    TermDictionary dictionary;
+    vector<TermId> new_term_ids(dictionary_.size(), TermDictionary::npos);
+    vector<TermId> live_terms;
+    for (TermId term_id = 0; term_id < dictionary_.size(); ++term_id) {
+        const WordData& word_data = word_to_document_freqs_[term_id];
+        if (IsStopTerm(term_id) || word_data.postings.size() > word_data.removed_count) {
+            new_term_ids[term_id] = dictionary.Add(dictionary_.GetTerm(term_id));
+            live_terms.push_back(term_id);
+        }
+    }
+
+    // каждый список перестраивает один поток
+    deque<WordData> word_to_document_freqs(live_terms.size());
+    vector<TermId> new_term_range(live_terms.size());
+    iota(new_term_range.begin(), new_term_range.end(), 0);
+    for_each(policy, new_term_range.begin(), new_term_range.end(), [&](TermId new_term_id) {
+        auto& postings = word_to_document_freqs[new_term_id].postings;
+        for (const auto [ordinal, term_freq] : word_to_document_freqs_[live_terms[new_term_id]].postings) {
+            if (new_ordinals[ordinal] >= 0) {
+                postings.emplace_hint(postings.end(), new_ordinals[ordinal], term_freq);
+            }
+        }
+    });
+
+    vector<vector<pair<TermId, double>>> document_to_word_freqs(live_ordinals.size());
+    vector<int> new_ordinal_range(live_ordinals.size());
+    iota(new_ordinal_range.begin(), new_ordinal_range.end(), 0);
+    for_each(policy, new_ordinal_range.begin(), new_ordinal_range.end(), [&](int new_ordinal) {
+        auto& word_freqs = document_to_word_freqs[new_ordinal];
+        word_freqs = move(document_to_word_freqs_[live_ordinals[new_ordinal]]);
+        for (auto& [term_id, term_freq] : word_freqs) {
+            term_id = new_term_ids[term_id];
+        }
+    });
+
+    const auto compact = [&live_ordinals](auto& values) {
+        for (size_t i = 0; i < live_ordinals.size(); ++i) {
+            values[i] = values[live_ordinals[i]];
+        }
+        values.resize(live_ordinals.size());
+        values.shrink_to_fit();
+    };
+    compact(document_ids_);
+    compact(document_ratings_);
+    compact(document_statuses_);
+    compact(document_word_counts_);
+    for (auto& [document_id, ordinal] : document_ordinals_) {
+        ordinal = new_ordinals[ordinal];
+    }
+
+    dictionary_ = move(dictionary);
+    word_to_document_freqs_ = move(word_to_document_freqs);
+    document_to_word_freqs_ = move(document_to_word_freqs);
+    vector<char>().swap(document_tombstones_);
+
+    if (was_frozen) {
+        Freeze(format, precision);
+    }
+}
+
+int SearchServer::GetOrdinal(int document_id) const {
+    const auto it = document_ordinals_.find(document_id);
+    if (it == document_ordinals_.end()) {
+        throw out_of_range("Invalid id");
+    }
+    return it->second;
+}
+
+
+TermId SearchServer::AddTerm(string_view word) {
+    const TermId term_id = dictionary_.Add(word);
+    if (term_id == word_to_document_freqs_.size()) {
+        word_to_document_freqs_.emplace_back();
+    }
+    return term_id;
 }
 
 int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
@@ -176,8 +1139,20 @@ int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
     return rating_sum / static_cast<int>(ratings.size());
 }
 
-bool SearchServer::IsStopWord(string_view word) const {
-    return stop_words_.count(word) > 0;
+bool SearchServer::IsStopTerm(TermId term_id) const {
+    return term_id < stop_term_count_;
+}
+
+void SearchServer::ComputeWordFreqs(vector<TermId>& term_ids, vector<pair<TermId, double>>& word_freqs) {
+    sort(term_ids.begin(), term_ids.end());
+    // частота - число вхождений, умноженное на 1 / число слов: так её можно
+    // точно восстановить из сжатого индекса
+    const double inv_word_count = 1.0 / term_ids.size();
+    for (auto first = term_ids.begin(); first != term_ids.end();) {
+        const auto last = upper_bound(first, term_ids.end(), *first);
+        word_freqs.emplace_back(*first, static_cast<double>(last - first) * inv_word_count);
+        first = last;
+    }
 }
 
 
@@ -187,7 +1162,13 @@ bool SearchServer::IsStopWord(string_view word) const {
     });
 }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
+SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text, bool check_symbols) const {
+    QueryWord query_word = SplitQueryWord(text, check_symbols);
+    query_word.term_id = dictionary_.Find(query_word.data);
+    return query_word;
+}
+
+SearchServer::QueryWord SearchServer::SplitQueryWord(string_view text, bool check_symbols) {
     bool is_minus = false;
     if (text[0] == '-') {
         is_minus = true;
@@ -195,48 +1176,207 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
             throw invalid_argument("Invalid request"s);
         text = text.substr(1);
     }
-    if (!IsValidWord(text))
+    if (check_symbols && !IsValidWord(text))
         throw invalid_argument("Invalid symbols"s);
 
-    return {text, is_minus, IsStopWord(text)};
+    return {text, is_minus, TermDictionary::npos};
 }
 
 SearchServer::Query SearchServer::ParseQuery(string_view text) const {
-    vector<string_view> plus_words;
-    vector<string_view> minus_words;
+    vector<TermId> plus_terms;
+    vector<TermId> minus_terms;
 
-    for (const string_view word : SplitIntoWords(text)) {
-        const QueryWord query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
+    // обычно текст проверяется при разбиении; при управляющем символе
+    // слова проверяются по порядку, чтобы ошибка была той же, что раньше
+    vector<string_view>& words = GetThreadWordBuffer();
+    const bool has_valid_symbols = SplitIntoValidWords(text, words);
+    if (!has_valid_symbols) {
+        words = SplitIntoWords(text);
+    }
+    for (const string_view word : words) {
+        const QueryWord query_word = ParseQueryWord(word, !has_valid_symbols);
+        // слова, которых нет в словаре, не встречаются ни в одном документе
+        if (query_word.term_id != TermDictionary::npos && !IsStopTerm(query_word.term_id)) {
             if (query_word.is_minus) {
-                minus_words.push_back(query_word.data);
+                minus_terms.push_back(query_word.term_id);
             }
             else {
-                plus_words.push_back(query_word.data);
+                plus_terms.push_back(query_word.term_id);
             }
         }
     }
 
-    return {plus_words, minus_words};
+    return {plus_terms, minus_terms};
 }
 
 SearchServer::Query SearchServer::ParseQueryForSeq(string_view text) const {
     
     Query result = ParseQuery(text);
 
-    sort(result.plus_words.begin(), result.plus_words.end());
-    auto last_plus_word = 
-    unique(result.plus_words.begin(), result.plus_words.end());
+    sort(result.plus_terms.begin(), result.plus_terms.end());
+    auto last_plus_term = 
+    unique(result.plus_terms.begin(), result.plus_terms.end());
+
+    sort(result.minus_terms.begin(), result.minus_terms.end());
+    auto last_minus_term = 
+    unique(result.minus_terms.begin(), result.minus_terms.end());
 
-    sort(result.minus_words.begin(), result.minus_words.end());
-    auto last_minus_word = 
-    unique(result.minus_words.begin(), result.minus_words.end());
+    return {vector<TermId>(result.plus_terms.begin(), last_plus_term),
+            vector<TermId>(result.minus_terms.begin(), last_minus_term)};
+}
+
+vector<SearchServer::QueryWord> SearchServer::SplitQueryWords(string_view text) {
+    vector<string_view>& words = GetThreadWordBuffer();
+    const bool has_valid_symbols = SplitIntoValidWords(text, words);
+    if (!has_valid_symbols) {
+        words = SplitIntoWords(text);
+    }
+    vector<QueryWord> query_words;
+    query_words.reserve(words.size());
+    for (const string_view word : words) {
+        query_words.push_back(SplitQueryWord(word, !has_valid_symbols));
+    }
+    return query_words;
+}
 
-    return {vector<string_view>(result.plus_words.begin(), last_plus_word),
-            vector<string_view>(result.minus_words.begin(), last_minus_word)};
+SearchServer::Query SearchServer::FindQueryTerms(const vector<QueryWord>& query_words) const {
+    Query query;
+    for (const QueryWord& query_word : query_words) {
+        const TermId term_id = dictionary_.Find(query_word.data);
+        if (term_id != TermDictionary::npos && !IsStopTerm(term_id)) {
+            (query_word.is_minus ? query.minus_terms : query.plus_terms).push_back(term_id);
+        }
+    }
+    for (vector<TermId>* terms : {&query.plus_terms, &query.minus_terms}) {
+        sort(terms->begin(), terms->end());
+        terms->erase(unique(terms->begin(), terms->end()), terms->end());
+    }
+    return query;
 }
 
-// Existence required
-double SearchServer::ComputeWordInverseDocumentFreq(string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+SearchServer::ResolvedQuery SearchServer::ResolveQuery(const Query& query) const {
+    ResolvedQuery resolved_query;
+    for (const TermId term_id : query.plus_terms) {
+        const WordPostings postings = FindPostings(term_id);
+        if (!postings.empty()) {
+            resolved_query.plus_postings.emplace_back(postings, GetInverseDocumentFreq(postings));
+        }
+    }
+    for (const TermId term_id : query.minus_terms) {
+        const WordPostings postings = FindPostings(term_id);
+        if (!postings.empty()) {
+            resolved_query.minus_postings.push_back(postings);
+        }
+    }
+    return resolved_query;
+}
+
+SearchServer::ResolvedQuery SearchServer::ResolveQuery(const Query& query,
+                                                       const vector<double>& inverse_document_freqs) const {
+    ResolvedQuery resolved_query;
+    for (size_t i = 0; i < query.plus_terms.size(); ++i) {
+        const WordPostings postings = FindPostings(query.plus_terms[i]);
+        if (!postings.empty()) {
+            resolved_query.plus_postings.emplace_back(postings, inverse_document_freqs[i]);
+        }
+    }
+    for (const TermId term_id : query.minus_terms) {
+        const WordPostings postings = FindPostings(term_id);
+        if (!postings.empty()) {
+            resolved_query.minus_postings.push_back(postings);
+        }
+    }
+    return resolved_query;
+}
+
+SearchServer::BatchTerm::BatchTerm(const WordPostings& postings, double inverse_document_freq)
+    : inverse_document_freq_(inverse_document_freq) {
+    if (postings.frozen_index_) {
+        frozen_cursor_.emplace(*postings.frozen_index_, postings.word_index_, 0, numeric_limits<int>::max());
+    } else {
+        it_ = postings.word_data_->postings.begin();
+        end_ = postings.word_data_->postings.end();
+    }
+}
+
+SearchServer::BatchPlan SearchServer::PlanBatch(const Query* queries, size_t query_count) const {
+    // (слово, номер запроса) по возрастанию слова
+    vector<pair<TermId, uint32_t>> plus_uses;
+    vector<pair<TermId, uint32_t>> minus_uses;
+    for (size_t i = 0; i < query_count; ++i) {
+        for (const TermId term_id : queries[i].plus_terms) {
+            plus_uses.emplace_back(term_id, static_cast<uint32_t>(i));
+        }
+        for (const TermId term_id : queries[i].minus_terms) {
+            minus_uses.emplace_back(term_id, static_cast<uint32_t>(i));
+        }
+    }
+
+    const auto group_terms = [this](vector<pair<TermId, uint32_t>>& uses, bool is_plus) {
+        sort(uses.begin(), uses.end());
+        vector<BatchTerm> terms;
+        for (size_t first = 0; first < uses.size();) {
+            size_t last = first + 1;
+            while (last < uses.size() && uses[last].first == uses[first].first) {
+                ++last;
+            }
+            const WordPostings postings = FindPostings(uses[first].first);
+            if (!postings.empty()) {
+                BatchTerm& term = terms.emplace_back(postings, is_plus ? GetInverseDocumentFreq(postings) : 0.0);
+                for (size_t i = first; i < last; ++i) {
+                    term.AddQuery(uses[i].second);
+                }
+            }
+            first = last;
+        }
+        return terms;
+    };
+    return {group_terms(plus_uses, true), group_terms(minus_uses, false)};
+}
+
+int SearchServer::ComputeRangeSize(int ordinal_count) {
+    // несколько диапазонов на поток для балансировки, но не слишком мелкие
+    const int range_count = 4 * max(1u, thread::hardware_concurrency());
+    return clamp(ordinal_count / range_count + 1, 1 << 12, 1 << 16);
+}
+
+RelevanceAccumulator& SearchServer::GetThreadAccumulator() {
+    thread_local RelevanceAccumulator accumulator;
+    return accumulator;
+}
+
+vector<RelevanceAccumulator>& SearchServer::GetThreadBatchAccumulators() {
+    thread_local vector<RelevanceAccumulator> accumulators;
+    return accumulators;
+}
+
+vector<TopDocuments>& SearchServer::GetThreadBatchTops() {
+    thread_local vector<TopDocuments> tops;
+    return tops;
+}
+
+int SearchServer::ComputeBatchRangeSize(size_t query_count) {
+    // 2^17 ячеек аккумуляторов - около мегабайта
+    return clamp(static_cast<int>((size_t{1} << 17) / max<size_t>(1, query_count)), 1 << 9, 1 << 16);
+}
+
+vector<string_view>& SearchServer::GetThreadWordBuffer() {
+    thread_local vector<string_view> words;
+    return words;
+}
+
+double SearchServer::ComputeInverseDocumentFreq(size_t document_freq) const {
+    return log(GetDocumentCount() * 1.0 / document_freq);
+}
+
+double SearchServer::GetInverseDocumentFreq(const WordPostings& postings) const {
+    // и для замороженного индекса по действующим документам: после удаления
+    // без разморозки IDF, вычисленный при заморозке, устаревает
+    const WordData& word_data = *postings.word_data_;
+    // одновременный пересчёт из нескольких потоков запишет одно и то же значение
+    if (word_data.idf_generation.load(memory_order_acquire) != generation_) {
+        word_data.inverse_document_freq.store(ComputeInverseDocumentFreq(postings.size()), memory_order_relaxed);
+        word_data.idf_generation.store(generation_, memory_order_release);
+    }
+    return word_data.inverse_document_freq.load(memory_order_relaxed);
 }
\ No newline at end of file
@@ -10,21 +10,32 @@
 #include "string_processing.h"
 #include "log_duration.h"
 #include "document.h"
-#include "concurrent_map.h"
+#include "frozen_index.h"
+#include "relevance_accumulator.h"
+#include "result_cache.h"
+#include "term_dictionary.h"
+#include "top_documents.h"
+#include "write_ahead_log.h"
 #include <stdexcept>
+#include <deque>
+#include <exception>
 #include <map>
 #include <algorithm>
 #include <numeric>
+#include <optional>
 #include <cmath>
+#include <atomic>
 #include <execution>
+#include <iterator>
+#include <limits>
+#include <memory>
 #include <string_view>
 #include <thread>
+#include <type_traits>
+#include <unordered_set>
 
 // здесь было using namespace
 
-const double COMPARE_TOLERANCE = 1e-6;
-const int MAX_RESULT_DOCUMENT_COUNT = 5;
-
 class SearchServer {
 public:
 
@@ -35,20 +46,64 @@ public:
 
     void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
+    // Пакетное добавление: тексты разбираются параллельно, обратный индекс
+    // собирается из частичных индексов групп документов. Ошибки те же, что
+    // у AddDocument, и проверяются в порядке пакета; результат - исключение
+    // для каждого документа, nullptr для добавленных
+    std::vector<std::exception_ptr> AddDocuments(const std::vector<DocumentInput>& documents);
+    std::vector<std::exception_ptr> AddDocuments(std::execution::sequenced_policy policy,
+                                                 const std::vector<DocumentInput>& documents);
+    std::vector<std::exception_ptr> AddDocuments(std::execution::parallel_policy policy,
+                                                 const std::vector<DocumentInput>& documents);
+
     
+    // top_k - сколько лучших документов вернуть
     template <typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(std::string_view raw_query,
-                                           DocumentPredicate document_predicate) const;
+                                           DocumentPredicate document_predicate,
+                                           size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
     std::vector<Document> FindTopDocuments(std::string_view raw_query, 
-                                 DocumentStatus status = DocumentStatus::ACTUAL) const;
+                                 DocumentStatus status = DocumentStatus::ACTUAL,
+                                 size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
 
     template <typename ExecutionPolicy, typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
-                                           DocumentPredicate document_predicate) const;
+                                           DocumentPredicate document_predicate,
+                                           size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
     template <typename ExecutionPolicy>
     std::vector<Document> 
     FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, 
-                     DocumentStatus status = DocumentStatus::ACTUAL) const;
+                     DocumentStatus status = DocumentStatus::ACTUAL,
+                     size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    // Пакет запросов с общим обходом списков документов: список каждого
+    // слова, встречающегося в пакете, читается один раз, и вклад слова
+    // раскладывается по аккумуляторам всех запросов с этим словом. Минус-слова
+    // и отбор top_k у каждого запроса свои. Результаты те же, что у
+    // FindTopDocuments по каждому запросу; ошибка разбора любого запроса -
+    // исключение для всего пакета
+    template <typename DocumentPredicate>
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string_view>& raw_queries,
+                                                             DocumentPredicate document_predicate,
+                                                             size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string_view>& raw_queries,
+                                                             DocumentStatus status = DocumentStatus::ACTUAL,
+                                                             size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+    // То же без вектора на каждый запрос: документы дописываются в documents,
+    // после каждого запроса в offsets дописывается documents.size()
+    void FindTopDocumentsBatch(const std::vector<std::string_view>& raw_queries, DocumentStatus status,
+                               size_t top_k, std::vector<Document>& documents, std::vector<size_t>& offsets) const;
+    // То же в заранее размеченный буфер: документы запроса i записываются в
+    // [documents + offsets[i], documents + offsets[i + 1]), размер части -
+    // CountTopDocuments запроса
+    void FindTopDocumentsBatch(const std::vector<std::string_view>& raw_queries, DocumentStatus status,
+                               size_t top_k, Document* documents, const size_t* offsets) const;
+
+    // Сколько документов вернёт FindTopDocuments с теми же аргументами.
+    // Релевантность не считается, и обход списков заканчивается, как только
+    // набралось top_k документов
+    size_t CountTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL,
+                             size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
 
     int GetDocumentCount() const;
 
@@ -62,8 +117,12 @@ public:
     MatchResult 
     MatchDocument(std::string_view raw_query, int document_id) const;
     
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
 
+    // Документ отмечается удалённым и пропускается при ранжировании, списки
+    // документов слов не перестраиваются. Место освобождает Compact; она
+    // запускается сама, когда удалённых документов больше, чем действующих,
+    // с seq для seq и с par для остальных политик
     template <class ExecutionPolicy>
     void RemoveDocument(ExecutionPolicy&& policy, int document_id);
 
@@ -71,56 +130,412 @@ public:
         RemoveDocument(std::execution::seq, document_id);
     }
 
-    std::set<int>::const_iterator begin() const;
-    std::set<int>::const_iterator end() const;
+    // Пакетное удаление. В отличие от RemoveDocument, в изменяемом индексе
+    // документы пакета сразу убираются из списков слов, а не помечаются
+    // удалёнными: список каждого слова чистится один раз за пакет, с par
+    // разные слова обрабатываются параллельно. Замороженный индекс с точными
+    // весами пакет, как и RemoveDocument, не перестраивает, а помечает
+    // документы удалёнными до Compact. Неизвестные и повторные id
+    // пропускаются. В журнал пакет подтверждается одной синхронизацией
+    void RemoveDocuments(const std::vector<int>& document_ids);
+    void RemoveDocuments(std::execution::sequenced_policy policy, const std::vector<int>& document_ids);
+    void RemoveDocuments(std::execution::parallel_policy policy, const std::vector<int>& document_ids);
 
-private:
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
-        std::string_view doc_text; // string view для хранения текста
+    // Замена текста, статуса и оценок документа без смены номера: новый
+    // прямой индекс сравнивается со старым, и меняются только списки слов,
+    // которые появились, пропали или изменили частоту. Замороженный индекс,
+    // как при добавлении, возвращается в изменяемый вид. Неизвестный id -
+    // out_of_range, ошибки текста те же, что у AddDocument
+    void UpdateDocument(int document_id, std::string_view document, DocumentStatus status,
+                        const std::vector<int>& ratings);
+    // Только свойства документа, за O(1) и без размораживания индекса
+    void SetStatus(int document_id, DocumentStatus status);
+    void SetRating(int document_id, const std::vector<int>& ratings);
+
+    // Сборка мусора после удалений: из списков документов убираются
+    // удалённые, из словаря - слова без документов, номера документов и слов
+    // снова идут подряд. Замороженный индекс перестраивается в том же формате.
+    // С par списки слов перестраиваются параллельно. Как и другие изменения,
+    // не выполняется одновременно с запросами
+    void Compact();
+    void Compact(std::execution::sequenced_policy policy);
+    void Compact(std::execution::parallel_policy policy);
+
+    // Перевод индекса в неизменяемый CSR-формат для обслуживания запросов.
+    // Добавление и удаление документов возвращают индекс в изменяемый вид.
+    // PostingFormat::COMPRESSED хранит списки сжатыми блоками: памяти
+    // в несколько раз меньше, результаты поиска те же.
+    // С квантованными весами (ImpactPrecision) релевантность при полном
+    // переборе приближённая, оценка погрешности - в frozen_index.h.
+    // С динамическим отсечением релевантность всегда точная
+    void Freeze(PostingFormat format = PostingFormat::PLAIN, ImpactPrecision precision = ImpactPrecision::EXACT);
+    bool IsFrozen() const;
+
+    // Снимок индекса: стоп-слова, словарь, прямой и обратный индексы,
+    // свойства документов. Формат с версией и контрольной суммой.
+    // Загруженный сервер заморожен и отвечает на запросы прямо из
+    // отображённого в память файла; первое изменение переносит индекс в память
+    void SaveSnapshot(const std::string& path) const;
+    static SearchServer LoadSnapshot(const std::string& path);
+
+    // Журнал изменений. Сначала применяются записи журнала, которых нет
+    // в сервере (например, сделанные после снимка), затем каждое
+    // изменение документов записывается в журнал до того, как меняется
+    // индекс: если журнал выбросил исключение, индекс остался прежним.
+    // С LogCommitMode::EACH_CHANGE изменение ещё и ждёт подтверждения
+    // записи по политике синхронизации журнала; пакеты подтверждаются
+    // одной синхронизацией, но отдельные изменения единственного писателя
+    // синхронизируются каждое по отдельности.
+    // С LogCommitMode::DEFERRED изменения объединяются: писатель берёт
+    // GetAppliedLsn() под своей блокировкой и вызывает log->Commit(lsn)
+    // уже после неё, так что ожидания нескольких потоков или нескольких
+    // изменений подряд обходятся одной синхронизацией
+    void AttachLog(std::shared_ptr<WriteAheadLog> log, LogCommitMode commit_mode = LogCommitMode::EACH_CHANGE);
+    // LSN последней записи журнала, отражённой в индексе
+    uint64_t GetAppliedLsn() const;
+    // Снимок, затем удаление вошедших в него записей журнала
+    void Checkpoint(const std::string& snapshot_path);
+
+    // Обход документов с динамическим отсечением (Block-Max WAND) вместо
+    // подсчёта каждого документа. Действует на замороженном индексе,
+    // результаты совпадают с полным перебором
+    void SetDynamicPruning(bool enabled);
+
+    // Кэш результатов FindTopDocuments с отбором по статусу; запросы с
+    // предикатом не кэшируются. Ключ - статус, top_k и слова запроса без
+    // повторов и порядка; повтор того же текста запроса находится без
+    // разбора. Любое изменение набора документов делает прежние записи
+    // недействительными. max_memory_bytes = 0 отключает кэш
+    void EnableResultCache(size_t max_memory_bytes);
+    ResultCacheStats GetResultCacheStats() const;
+
+    // Обход внешних id документов по возрастанию
+    class DocumentIdIterator {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = int;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const int*;
+        using reference = const int&;
+
+        explicit DocumentIdIterator(std::map<int, int>::const_iterator it)
+            : it_(it) {
+        }
+
+        reference operator*() const {
+            return it_->first;
+        }
+        pointer operator->() const {
+            return &it_->first;
+        }
+        DocumentIdIterator& operator++() {
+            ++it_;
+            return *this;
+        }
+        DocumentIdIterator operator++(int) {
+            return DocumentIdIterator(it_++);
+        }
+        DocumentIdIterator& operator--() {
+            --it_;
+            return *this;
+        }
+        DocumentIdIterator operator--(int) {
+            return DocumentIdIterator(it_--);
+        }
+        bool operator==(const DocumentIdIterator& other) const {
+            return it_ == other.it_;
+        }
+        bool operator!=(const DocumentIdIterator& other) const {
+            return it_ != other.it_;
+        }
+
+    private:
+        std::map<int, int>::const_iterator it_;
     };
-    
+
+    DocumentIdIterator begin() const;
+    DocumentIdIterator end() const;
+
+private:
+    // сегменты и шарды - обычные SearchServer, ранжируемые с общей статистикой
+    friend class SegmentedSearchServer;
+    friend class ShardedSearchServer;
+
     struct QueryWord {
         std::string_view data;
         bool is_minus;
-        bool is_stop;
+        TermId term_id;
     };
     
+    // Слова запроса, известные индексу, без стоп-слов
     struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        std::vector<TermId> plus_terms;
+        std::vector<TermId> minus_terms;
+    };
+
+    struct WordData {
+        // включая удалённые документы до Compact
+        std::map<int, double> postings;
+        // сколько документов postings или списка замороженного индекса удалено
+        size_t removed_count = 0;
+        // IDF слова, действителен пока idf_generation равен generation_ сервера.
+        // Пересчитывается лениво при первом запросе после изменения индекса
+        mutable std::atomic<uint64_t> idf_generation{0};
+        mutable std::atomic<double> inverse_document_freq{0.0};
+    };
+
+    // Список документов слова: из изменяемого словаря либо из замороженного индекса
+    class WordPostings {
+    public:
+        WordPostings() = default;
+        explicit WordPostings(const WordData* word_data)
+            : word_data_(word_data) {
+        }
+        // word_data - счётчик удалённых документов слова замороженного индекса
+        WordPostings(const FrozenIndex* frozen_index, size_t word_index, const WordData* word_data)
+            : word_data_(word_data)
+            , frozen_index_(frozen_index)
+            , word_index_(word_index) {
+        }
+
+        size_t size() const;
+        bool empty() const {
+            return size() == 0;
+        }
+        bool contains(int ordinal) const;
+
+        template <typename Func>
+        void ForEach(Func func) const;
+        // только документы с номерами из [first, last)
+        template <typename Func>
+        void ForEachInRange(int first, int last, Func func) const;
+
+    private:
+        friend class SearchServer;
+
+        const WordData* word_data_ = nullptr;
+        const FrozenIndex* frozen_index_ = nullptr;
+        size_t word_index_ = 0;
     };
 
     const std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, std::map<std::string_view, double>> document_to_word_freqs_;
-    std::set<std::string> all_words_;
-    std::map<int, DocumentData> documents_;
-    std::set<int> id_list_;
+    // Стоп-слова добавляются в словарь первыми и получают номера
+    // [0, stop_term_count_), так что разбор слова - одна проба в словаре
+    TermDictionary dictionary_;
+    TermId stop_term_count_ = 0;
+    // Индекс хранит внутренние номера документов (ordinal), выдаваемые подряд
+    // при добавлении; внешние id нужны только на границе API.
+    // Списки документов - по TermId, прямой индекс отсортирован по TermId
+    std::deque<WordData> word_to_document_freqs_;
+    std::vector<std::vector<std::pair<TermId, double>>> document_to_word_freqs_;
+    std::map<int, int> document_ordinals_;
+    std::vector<int> document_ids_;
+    std::vector<int> document_ratings_;
+    std::vector<DocumentStatus> document_statuses_;
+    // отметки удалённых документов, ещё оставшихся в списках слов;
+    // короче document_ids_, если последние документы не удалялись
+    std::vector<char> document_tombstones_;
+    // число слов документа без стоп-слов
+    std::vector<int> document_word_counts_;
+    FrozenIndex frozen_index_;
+    bool is_frozen_ = false;
+    // Прямой индекс из снимка, читается на месте
+    struct SnapshotForwardIndex {
+        FrozenArray<size_t> offsets;
+        FrozenArray<TermId> term_ids;
+        FrozenArray<double> term_freqs;
+    };
+    SnapshotForwardIndex snapshot_forward_index_;
+    std::shared_ptr<const MappedFile> snapshot_file_;
+    bool dynamic_pruning_ = false;
+    // увеличивается при каждом изменении набора документов
+    uint64_t generation_ = 1;
+    // увеличивается при изменении статуса или рейтинга: списки слов и IDF
+    // прежние, меняется только выдача
+    uint64_t attribute_generation_ = 0;
+    std::shared_ptr<WriteAheadLog> log_;
+    LogCommitMode log_commit_mode_ = LogCommitMode::EACH_CHANGE;
+    // указатель, чтобы сервер оставался перемещаемым
+    std::unique_ptr<ResultCache> result_cache_;
+    // LSN последней записи журнала, отражённой в индексе; сохраняется в снимке
+    uint64_t applied_lsn_ = 0;
 
-    bool IsStopWord(std::string_view word) const;
+    void Thaw();
+    // Замороженный индекс с точными весами при удалении не размораживается:
+    // документ помечается удалённым, его слова остаются в списках до Compact
+    // или новой заморозки. В квантованные веса вшит IDF, такой индекс размораживается
+    bool CanRemoveWithoutThaw() const;
+    void RemoveFrozenDocument(int ordinal);
+    FrozenIndex BuildFrozenIndex(PostingFormat format, ImpactPrecision precision) const;
+    // func(номер слова, частота) для слов документа
+    template <typename Func>
+    void ForEachWordFreq(int ordinal, Func func) const;
+    int GetOrdinal(int document_id) const;
+    bool IsRemoved(int ordinal) const {
+        return static_cast<size_t>(ordinal) < document_tombstones_.size() && document_tombstones_[ordinal];
+    }
+    // Удалённых документов больше, чем действующих
+    bool NeedsCompaction() const;
+    template <typename ExecutionPolicy>
+    void CompactImpl(ExecutionPolicy policy);
+    void LogRemoveDocument(int document_id);
+    // Ждёт подтверждения записей до applied_lsn_, если этого требует режим журнала
+    void CommitLog();
+    // Переносит живые документы other, кроме excluded_ids, с их частотами слов;
+    // тексты для этого не нужны
+    void ImportDocuments(const SearchServer& other, const std::unordered_set<int>& excluded_ids);
+    WordPostings FindPostings(TermId term_id) const;
+
+    TermId AddTerm(std::string_view word);
+    bool IsStopTerm(TermId term_id) const;
+    // Сортирует номера слов документа и считает их частоты
+    static void ComputeWordFreqs(std::vector<TermId>& term_ids, std::vector<std::pair<TermId, double>>& word_freqs);
+
+    template <typename ExecutionPolicy>
+    std::vector<std::exception_ptr> AddDocumentsImpl(ExecutionPolicy policy,
+                                                     const std::vector<DocumentInput>& documents);
+    template <typename ExecutionPolicy>
+    void RemoveDocumentsImpl(ExecutionPolicy policy, const std::vector<int>& document_ids);
 
-    std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view text) const;
     [[nodiscard]] static bool IsValidWord(const std::string_view word);
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
-    QueryWord ParseQueryWord(std::string_view text) const;
+    QueryWord ParseQueryWord(std::string_view text, bool check_symbols) const;
+    // Проверка слова запроса без поиска в словаре; term_id не заполняется
+    static QueryWord SplitQueryWord(std::string_view text, bool check_symbols);
 
     SearchServer::Query ParseQuery(std::string_view text) const;
     SearchServer::Query ParseQueryForSeq(std::string_view text) const;
+    // Разбор и проверка запроса без словаря, ошибки те же, что у ParseQuery:
+    // запрос разбирается один раз для нескольких индексов
+    static std::vector<QueryWord> SplitQueryWords(std::string_view text);
+    // Как ParseQueryForSeq для слов из SplitQueryWords
+    SearchServer::Query FindQueryTerms(const std::vector<QueryWord>& query_words) const;
 
-    
-        template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(std::execution::sequenced_policy, const Query& query,
-                                            DocumentPredicate document_predicate) const;
+    // Документы, удалённые из неизменяемого индекса без его перестройки.
+    // Номера удалённых документов дописываются в журнал, positions[номер] -
+    // позиция в журнале. Читатель видит первые visible_count записей
+    struct DeletedDocuments {
+        const std::atomic<uint32_t>* positions = nullptr;
+        uint32_t visible_count = 0;
+
+        bool Contains(int ordinal) const {
+            return visible_count > 0 && positions[ordinal].load(std::memory_order_acquire) < visible_count;
+        }
+    };
 
+    // Слова запроса, найденные в индексе, с их IDF
+    struct ResolvedQuery {
+        std::vector<std::pair<WordPostings, double>> plus_postings;
+        std::vector<WordPostings> minus_postings;
+        DeletedDocuments deleted_documents;
+    };
+
+    ResolvedQuery ResolveQuery(const Query& query) const;
+    // IDF плюс-слов задаётся извне, по порядку query.plus_terms: так составной
+    // индекс ранжирует свои части по статистике всего набора документов
+    ResolvedQuery ResolveQuery(const Query& query, const std::vector<double>& inverse_document_freqs) const;
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindCachedTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                                 uint32_t filter_tag, DocumentPredicate document_predicate,
+                                                 size_t top_k) const;
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    ResultCache::Results FindCachedResults(ExecutionPolicy&& policy, std::string_view raw_query,
+                                           uint32_t filter_tag, DocumentPredicate document_predicate,
+                                           size_t top_k) const;
+    // поколение записей кэша результатов; растёт при любом изменении выдачи
+    uint64_t GetResultGeneration() const {
+        return generation_ + attribute_generation_;
+    }
+
+    // больше запросов пакет ранжирует частями, чтобы ограничить память аккумуляторов
+    static constexpr size_t MAX_BATCH_QUERY_COUNT = 256;
+
+    // Слово пакета запросов и номера запросов пакета, где оно встречается.
+    // Диапазоны документов обходятся по возрастанию, и позиция в списке
+    // документов слова переходит от диапазона к следующему: список читается
+    // один раз за пакет, без поиска начала каждого диапазона
+    class BatchTerm {
+    public:
+        BatchTerm(const WordPostings& postings, double inverse_document_freq);
+
+        double GetInverseDocumentFreq() const {
+            return inverse_document_freq_;
+        }
+        const std::vector<uint32_t>& GetQueries() const {
+            return queries_;
+        }
+        void AddQuery(uint32_t query) {
+            queries_.push_back(query);
+        }
+
+        // func(номер, частота) для следующих документов с номерами меньше last
+        template <typename Func>
+        void ForEachBefore(int last, Func func);
+        // то же с квантованным весом; только для замороженного индекса
+        template <typename Func>
+        void ForEachImpactBefore(int last, Func func);
+
+    private:
+        double inverse_document_freq_;
+        std::vector<uint32_t> queries_;
+        std::optional<FrozenIndex::Cursor> frozen_cursor_;
+        std::map<int, double>::const_iterator it_;
+        std::map<int, double>::const_iterator end_;
+    };
+
+    // Слова пакета по возрастанию TermId, без слов, которых нет в индексе
+    struct BatchPlan {
+        std::vector<BatchTerm> plus_terms;
+        std::vector<BatchTerm> minus_terms;
+    };
+
+    BatchPlan PlanBatch(const Query* queries, size_t query_count) const;
+
+    // Ранжирование пакета с отбором по статусу без кэша результатов;
+    // write_result(номер запроса, TopDocuments&) - по порядку запросов
+    template <typename ResultWriter>
+    void RankQueries(const std::vector<std::string_view>& raw_queries, DocumentStatus status, size_t top_k,
+                     ResultWriter write_result) const;
+
+    // Ранжирование части пакета; запросов не больше MAX_BATCH_QUERY_COUNT.
+    // write_result(номер запроса в части, TopDocuments&) - по порядку запросов
+    template <typename DocumentPredicate, typename ResultWriter>
+    void RankBatch(const Query* queries, size_t query_count, DocumentPredicate& document_predicate,
+                   size_t top_k, ResultWriter write_result) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> RankDocuments(std::execution::sequenced_policy, const ResolvedQuery& query,
+                                        DocumentPredicate document_predicate, size_t top_k) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> RankDocuments(std::execution::parallel_policy, const ResolvedQuery& query,
+                                        DocumentPredicate document_predicate, size_t top_k) const;
+
+    // Ранжирование документов с номерами из [first, last) в top
+    template <typename DocumentPredicate>
+    void RankRange(const ResolvedQuery& query, DocumentPredicate& document_predicate,
+                   int first, int last, TopDocuments& top) const;
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(std::execution::parallel_policy, const Query& query,
-                                            DocumentPredicate document_predicate) const;
+    void RankRangeWithPruning(const ResolvedQuery& query, DocumentPredicate& document_predicate,
+                              int first, int last, TopDocuments& top) const;
+
+    static int ComputeRangeSize(int ordinal_count);
+    static RelevanceAccumulator& GetThreadAccumulator();
+    // аккумуляторы запросов пакета, свои у каждого потока
+    static std::vector<RelevanceAccumulator>& GetThreadBatchAccumulators();
+    // кучи лучших документов запросов пакета, свои у каждого потока
+    static std::vector<TopDocuments>& GetThreadBatchTops();
+    // Документов в диапазоне пакетного обхода: аккумуляторы всех запросов
+    // части пакета на один диапазон помещаются в кэш процессора
+    static int ComputeBatchRangeSize(size_t query_count);
+    // буфер слов для разбора текста, свой у каждого потока
+    static std::vector<std::string_view>& GetThreadWordBuffer();
     
-    double ComputeWordInverseDocumentFreq(std::string_view word) const;
+    double ComputeInverseDocumentFreq(size_t document_freq) const;
+    double GetInverseDocumentFreq(const WordPostings& postings) const;
 };
 
 // реализация шаблонов
@@ -131,152 +546,487 @@ SearchServer::SearchServer(const StringContainer& stop_words)
     for (const auto& word : stop_words_){
         if(!IsValidWord(word))
             throw std::invalid_argument("Invalid word: " + word);
+        AddTerm(word);
     }
+    stop_term_count_ = static_cast<TermId>(dictionary_.size());
 }
 
 template <typename ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
-                                                         DocumentPredicate document_predicate) const{
+                                                         DocumentPredicate document_predicate, size_t top_k) const{
     
     const auto query = ParseQueryForSeq(raw_query);
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
-
-    std::sort(policy, matched_documents.begin(), matched_documents.end(),
-            [](const Document& lhs, const Document& rhs) {
-                if (std::abs(lhs.relevance - rhs.relevance) < COMPARE_TOLERANCE) {
-                    return lhs.rating > rhs.rating;
-                } else {
-                    return lhs.relevance > rhs.relevance;
-                }
-            });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-
-    return  matched_documents;
+    return RankDocuments(policy, ResolveQuery(query), document_predicate, top_k);
 }
 
 template <typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
-                                        DocumentPredicate document_predicate) const{
-    return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+                                        DocumentPredicate document_predicate, size_t top_k) const{
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate, top_k);
 }
 
 template <typename ExecutionPolicy>
 std::vector<Document> 
-SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status) const{
+SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status,
+                               size_t top_k) const{
 
-    return FindTopDocuments(policy,
-            raw_query, 
-            [status](int document_id, DocumentStatus document_status, int rating) {
-                  return document_status == status;
-            });
+    const auto document_predicate = [status](int, DocumentStatus document_status, int) {
+        return document_status == status;
+    };
+    if (result_cache_) {
+        return FindCachedTopDocuments(policy, raw_query, static_cast<uint32_t>(status), document_predicate, top_k);
+    }
+    return FindTopDocuments(policy, raw_query, document_predicate, top_k);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SearchServer::FindCachedTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                                           uint32_t filter_tag, DocumentPredicate document_predicate,
+                                                           size_t top_k) const {
+    return *FindCachedResults(policy, raw_query, filter_tag, document_predicate, top_k);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+ResultCache::Results SearchServer::FindCachedResults(ExecutionPolicy&& policy, std::string_view raw_query,
+                                                     uint32_t filter_tag, DocumentPredicate document_predicate,
+                                                     size_t top_k) const {
+    const uint64_t generation = GetResultGeneration();
+    std::string text_key = ResultCache::MakeTextKey(raw_query, filter_tag, top_k);
+    if (ResultCache::Results results = result_cache_->Find(text_key, generation)) {
+        result_cache_->CountHit();
+        return results;
+    }
+
+    // тот же запрос в другой записи: разбор нужен, ранжирование - нет
+    const Query query = ParseQueryForSeq(raw_query);
+    std::string terms_key = ResultCache::MakeTermsKey(query.plus_terms, query.minus_terms, filter_tag, top_k);
+    ResultCache::Results results = result_cache_->Find(terms_key, generation);
+    if (results) {
+        result_cache_->CountHit();
+    } else {
+        result_cache_->CountMiss();
+        results = std::make_shared<const std::vector<Document>>(
+            RankDocuments(policy, ResolveQuery(query), document_predicate, top_k));
+        result_cache_->Insert(std::move(terms_key), generation, results);
+    }
+    result_cache_->Insert(std::move(text_key), generation, results);
+    return results;
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(std::execution::sequenced_policy, const Query& query,
-                                                     DocumentPredicate document_predicate) const{
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const std::vector<std::string_view>& raw_queries,
+                                                                       DocumentPredicate document_predicate,
+                                                                       size_t top_k) const {
+    std::vector<Query> queries;
+    queries.reserve(raw_queries.size());
+    for (const std::string_view raw_query : raw_queries) {
+        queries.push_back(ParseQueryForSeq(raw_query));
+    }
 
-    std::map<int, double> document_to_relevance;
+    std::vector<std::vector<Document>> results(queries.size());
+    // отсечение и так читает лишь малую часть списков, общий обход ему не нужен
+    if (is_frozen_ && dynamic_pruning_) {
+        for (size_t i = 0; i < queries.size(); ++i) {
+            results[i] = RankDocuments(std::execution::seq, ResolveQuery(queries[i]), document_predicate, top_k);
+        }
+        return results;
+    }
+    for (size_t first = 0; first < queries.size(); first += MAX_BATCH_QUERY_COUNT) {
+        const size_t query_count = std::min(MAX_BATCH_QUERY_COUNT, queries.size() - first);
+        RankBatch(queries.data() + first, query_count, document_predicate, top_k,
+                  [&results, first](size_t query, TopDocuments& top) {
+                      results[first + query] = top.Release();
+                  });
+    }
+    return results;
+}
 
-    for (std::string_view word : query.plus_words) {
-        auto it = word_to_document_freqs_.find(word);
-        if(it == word_to_document_freqs_.end())
-            continue;
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : it->second) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+// Документы обходятся диапазонами; в диапазоне слова идут по возрастанию
+// TermId, как плюс-слова в запросе, поэтому релевантность каждого запроса
+// складывается в том же порядке, что и при ранжировании по одному
+template <typename DocumentPredicate, typename ResultWriter>
+void SearchServer::RankBatch(const Query* queries, size_t query_count, DocumentPredicate& document_predicate,
+                             size_t top_k, ResultWriter write_result) const {
+    BatchPlan plan = PlanBatch(queries, query_count);
+    std::vector<TopDocuments>& tops = GetThreadBatchTops();
+    if (tops.size() < query_count) {
+        tops.resize(query_count, TopDocuments(top_k));
+    }
+    for (size_t query = 0; query < query_count; ++query) {
+        tops[query].Reset(top_k);
+    }
+
+    std::vector<RelevanceAccumulator>& accumulators = GetThreadBatchAccumulators();
+    if (accumulators.size() < query_count) {
+        accumulators.resize(query_count);
+    }
+    // аккумуляторы очищаются и при исключении из предиката
+    struct ClearGuard {
+        std::vector<RelevanceAccumulator>& accumulators;
+        size_t count;
+        ~ClearGuard() {
+            for (size_t i = 0; i < count; ++i) {
+                accumulators[i].Clear();
             }
         }
+    } clear_guard{accumulators, query_count};
+
+    const int ordinal_count = static_cast<int>(document_ids_.size());
+    const int range_size = ComputeBatchRangeSize(query_count);
+    for (size_t i = 0; i < query_count; ++i) {
+        accumulators[i].Resize(range_size);
     }
 
-    for (const std::string_view word : query.minus_words) {
-        auto it = word_to_document_freqs_.find(word);
-        if(it == word_to_document_freqs_.end())
-            continue;
-        for (const auto [document_id, _] : it->second) {
-            document_to_relevance.erase(document_id);
+    // квантованные веса складываются как целые, масштаб применяется к сумме
+    const bool is_quantized = is_frozen_ && frozen_index_.GetImpactPrecision() != ImpactPrecision::EXACT;
+    const double scale = is_quantized ? frozen_index_.GetImpactScale() : 1.0;
+    for (int first = 0; first < ordinal_count; first += range_size) {
+        const int last = std::min(ordinal_count, first + range_size);
+        for (BatchTerm& term : plan.plus_terms) {
+            const std::vector<uint32_t>& term_queries = term.GetQueries();
+            if (is_quantized) {
+                term.ForEachImpactBefore(last, [&accumulators, &term_queries, first](int ordinal, uint32_t impact) {
+                    for (const uint32_t query : term_queries) {
+                        accumulators[query].Add(ordinal - first, impact);
+                    }
+                });
+                continue;
+            }
+            const double idf = term.GetInverseDocumentFreq();
+            term.ForEachBefore(last, [&accumulators, &term_queries, first, idf](int ordinal, double term_freq) {
+                const double relevance = term_freq * idf;
+                for (const uint32_t query : term_queries) {
+                    accumulators[query].Add(ordinal - first, relevance);
+                }
+            });
+        }
+        for (BatchTerm& term : plan.minus_terms) {
+            const std::vector<uint32_t>& term_queries = term.GetQueries();
+            term.ForEachBefore(last, [&accumulators, &term_queries, first](int ordinal, double) {
+                for (const uint32_t query : term_queries) {
+                    accumulators[query].Exclude(ordinal - first);
+                }
+            });
+        }
+
+        for (size_t query = 0; query < query_count; ++query) {
+            accumulators[query].ForEachScored([&](size_t slot, double relevance) {
+                const int ordinal = first + static_cast<int>(slot);
+                if (!IsRemoved(ordinal)
+                        && document_predicate(document_ids_[ordinal], document_statuses_[ordinal], document_ratings_[ordinal])) {
+                    tops[query].Add({document_ids_[ordinal], relevance * scale, document_ratings_[ordinal]});
+                }
+            });
+            accumulators[query].Clear();
         }
     }
 
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back(
-            {document_id, relevance, documents_.at(document_id).rating});
+    for (size_t query = 0; query < query_count; ++query) {
+        write_result(query, tops[query]);
+    }
+}
+
+template <typename Func>
+void SearchServer::BatchTerm::ForEachBefore(int last, Func func) {
+    if (frozen_cursor_) {
+        for (; frozen_cursor_->IsValid() && frozen_cursor_->GetDocument() < last; frozen_cursor_->Next()) {
+            func(frozen_cursor_->GetDocument(), frozen_cursor_->GetTermFreq());
+        }
+        return;
+    }
+    for (; it_ != end_ && it_->first < last; ++it_) {
+        func(it_->first, it_->second);
+    }
+}
+
+template <typename Func>
+void SearchServer::BatchTerm::ForEachImpactBefore(int last, Func func) {
+    for (; frozen_cursor_->IsValid() && frozen_cursor_->GetDocument() < last; frozen_cursor_->Next()) {
+        func(frozen_cursor_->GetDocument(), frozen_cursor_->GetImpact());
+    }
+}
+
+template <typename Func>
+void SearchServer::WordPostings::ForEach(Func func) const {
+    if (frozen_index_) {
+        frozen_index_->ForEachPosting(word_index_, func);
+    } else if (word_data_) {
+        for (const auto [document_id, term_freq] : word_data_->postings) {
+            func(document_id, term_freq);
+        }
+    }
+}
+
+template <typename Func>
+void SearchServer::WordPostings::ForEachInRange(int first, int last, Func func) const {
+    if (frozen_index_) {
+        frozen_index_->ForEachPostingInRange(word_index_, first, last, func);
+    } else if (word_data_) {
+        const auto end = word_data_->postings.end();
+        for (auto it = word_data_->postings.lower_bound(first); it != end && it->first < last; ++it) {
+            func(it->first, it->second);
+        }
     }
-    return matched_documents;
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(std::execution::parallel_policy, const Query& query,
-                                                     DocumentPredicate document_predicate) const{
-
-    ConcurrentMap<int, double> document_to_relevance(std::thread::hardware_concurrency());
-
-    std::for_each(std::execution::par, query.plus_words.begin(), query.plus_words.end(), 
-        [this, document_predicate, &document_to_relevance](std::string_view word) {
-            auto it = word_to_document_freqs_.find(word);
-            if(it == word_to_document_freqs_.end())
-                return;
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto [document_id, term_freq] : it->second) {
-                const auto& document_data = documents_.at(document_id);
-                if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                    document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-                }
-            }   
-    });
+std::vector<Document> SearchServer::RankDocuments(std::execution::sequenced_policy, const ResolvedQuery& resolved_query,
+                                                  DocumentPredicate document_predicate, size_t top_k) const{
+    TopDocuments top(top_k);
+    if (!resolved_query.plus_postings.empty()) {
+        RankRange(resolved_query, document_predicate, 0, static_cast<int>(document_ids_.size()), top);
+    }
+    return top.Release();
+}
 
-    std::for_each(std::execution::par, query.minus_words.begin(), query.minus_words.end(), 
-        [this, &document_to_relevance](std::string_view word) {
-            auto it = word_to_document_freqs_.find(word);
-            if(it == word_to_document_freqs_.end())
-                return;
-            for (const auto [document_id, _] : it->second) {
-                document_to_relevance.Erase(document_id);
-            }
-            
+// Пространство номеров документов делится на диапазоны, каждый диапазон
+// считается в собственном аккумуляторе потока без блокировок и даёт свои top_k
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::RankDocuments(std::execution::parallel_policy, const ResolvedQuery& resolved_query,
+                                                  DocumentPredicate document_predicate, size_t top_k) const{
+
+    if (resolved_query.plus_postings.empty()) {
+        return {};
+    }
+
+    const int ordinal_count = static_cast<int>(document_ids_.size());
+    const int range_size = ComputeRangeSize(ordinal_count);
+    const int range_count = (ordinal_count + range_size - 1) / range_size;
+    std::vector<int> ranges(range_count);
+    std::iota(ranges.begin(), ranges.end(), 0);
+    std::vector<TopDocuments> range_tops(range_count, TopDocuments(top_k));
+
+    std::for_each(std::execution::par, ranges.begin(), ranges.end(),
+        [&](int range) {
+            const int first = range * range_size;
+            const int last = std::min(ordinal_count, first + range_size);
+            RankRange(resolved_query, document_predicate, first, last, range_tops[range]);
         });
 
-    auto ordinary_map = document_to_relevance.BuildOrdinaryMap();
+    TopDocuments top(top_k);
+    for (const TopDocuments& range_top : range_tops) {
+        top.Merge(range_top);
+    }
+    return top.Release();
+}
+
+template <typename DocumentPredicate>
+void SearchServer::RankRange(const ResolvedQuery& query, DocumentPredicate& document_predicate,
+                             int first, int last, TopDocuments& top) const {
+    if (is_frozen_ && dynamic_pruning_) {
+        RankRangeWithPruning(query, document_predicate, first, last, top);
+        return;
+    }
+
+    RelevanceAccumulator::Lease accumulator(GetThreadAccumulator(), last - first);
 
-    std::vector<Document> matched_documents(ordinary_map.size());
+    // квантованные веса складываются как целые, масштаб применяется к сумме
+    const bool is_quantized = is_frozen_ && frozen_index_.GetImpactPrecision() != ImpactPrecision::EXACT;
+    const double scale = is_quantized ? frozen_index_.GetImpactScale() : 1.0;
+    for (const auto& [postings, inverse_document_freq] : query.plus_postings) {
+        if (is_quantized) {
+            frozen_index_.ForEachImpactInRange(postings.word_index_, first, last,
+                [&accumulator, first](int ordinal, uint32_t impact) {
+                    accumulator->Add(ordinal - first, impact);
+                });
+            continue;
+        }
+        const double idf = inverse_document_freq;
+        postings.ForEachInRange(first, last, [&accumulator, first, idf](int ordinal, double term_freq) {
+            accumulator->Add(ordinal - first, term_freq * idf);
+        });
+    }
+    for (const WordPostings& postings : query.minus_postings) {
+        postings.ForEachInRange(first, last, [&accumulator, first](int ordinal, double) {
+            accumulator->Exclude(ordinal - first);
+        });
+    }
 
-    std::transform(
-        std::execution::par,
-        ordinary_map.begin(),
-        ordinary_map.end(),
-        matched_documents.begin(),
-        [this](auto& id_relevance){
-            return Document{id_relevance.first, id_relevance.second, documents_.at(id_relevance.first).rating};
+    accumulator->ForEachScored([&](size_t slot, double relevance) {
+        const int ordinal = first + static_cast<int>(slot);
+        if (!query.deleted_documents.Contains(ordinal) && !IsRemoved(ordinal)
+                && document_predicate(document_ids_[ordinal], document_statuses_[ordinal], document_ratings_[ordinal])) {
+            top.Add({document_ids_[ordinal], relevance * scale, document_ratings_[ordinal]});
+        }
     });
+}
+
+// Block-Max WAND: документы обходятся по возрастанию номера, полностью
+// считаются только те, чья верхняя оценка релевантности (по максимумам
+// слов и их блоков) позволяет попасть в текущие top_k. Запас
+// COMPARE_TOLERANCE сохраняет выдачу такой же, как при полном переборе
+template <typename DocumentPredicate>
+void SearchServer::RankRangeWithPruning(const ResolvedQuery& query, DocumentPredicate& document_predicate,
+                                        int first, int last, TopDocuments& top) const {
+    struct TermCursor {
+        FrozenIndex::Cursor cursor;
+        double inverse_document_freq;
+        double max_relevance;
+        size_t term;
+    };
+
+    std::vector<TermCursor> term_cursors;
+    term_cursors.reserve(query.plus_postings.size());
+    for (size_t term = 0; term < query.plus_postings.size(); ++term) {
+        const auto& [postings, inverse_document_freq] = query.plus_postings[term];
+        FrozenIndex::Cursor cursor(frozen_index_, postings.word_index_, first, last);
+        if (cursor.IsValid()) {
+            term_cursors.push_back({cursor, inverse_document_freq,
+                                    cursor.GetMaxTermFreq() * inverse_document_freq, term});
+        }
+    }
+    std::vector<FrozenIndex::Cursor> minus_cursors;
+    for (const WordPostings& postings : query.minus_postings) {
+        minus_cursors.emplace_back(frozen_index_, postings.word_index_, first, last);
+    }
+
+    std::vector<TermCursor*> order;
+    for (TermCursor& term_cursor : term_cursors) {
+        order.push_back(&term_cursor);
+    }
+    std::vector<double> relevances(query.plus_postings.size());
+    std::vector<char> matched(query.plus_postings.size());
 
-    return matched_documents;
+    // курсоры упорядочены по текущему документу, исчерпанные убираются
+    const auto restore_order = [&order]() {
+        order.erase(std::remove_if(order.begin(), order.end(),
+                                   [](const TermCursor* term_cursor) { return !term_cursor->cursor.IsValid(); }),
+                    order.end());
+        for (size_t i = 1; i < order.size(); ++i) {
+            for (size_t j = i; j > 0 && order[j]->cursor.GetDocument() < order[j - 1]->cursor.GetDocument(); --j) {
+                std::swap(order[j], order[j - 1]);
+            }
+        }
+    };
+
+    restore_order();
+    while (!order.empty()) {
+        // документ с оценкой не выше threshold не вытеснит худший из top_k
+        const double threshold = top.IsFull()
+                ? top.GetWorst().relevance - COMPARE_TOLERANCE
+                : -std::numeric_limits<double>::infinity();
+
+        double upper_bound = 0.0;
+        size_t pivot = order.size();
+        for (size_t i = 0; i < order.size(); ++i) {
+            upper_bound += order[i]->max_relevance;
+            if (upper_bound > threshold) {
+                pivot = i;
+                break;
+            }
+        }
+        if (pivot == order.size()) {
+            break;
+        }
+        const int pivot_document = order[pivot]->cursor.GetDocument();
+        while (pivot + 1 < order.size() && order[pivot + 1]->cursor.GetDocument() == pivot_document) {
+            ++pivot;
+        }
+
+        // оценка по блокам, в которые попадает pivot_document: если и она
+        // не выше порога, пропускаем документы до конца ближайшего блока
+        if (top.IsFull()) {
+            double block_upper_bound = 0.0;
+            int next_document = std::numeric_limits<int>::max();
+            for (size_t i = 0; i <= pivot; ++i) {
+                int block_last_document;
+                block_upper_bound += order[i]->cursor.GetBlockMaxTermFreq(pivot_document, block_last_document)
+                                     * order[i]->inverse_document_freq;
+                if (block_last_document < std::numeric_limits<int>::max()) {
+                    next_document = std::min(next_document, block_last_document + 1);
+                }
+            }
+            if (block_upper_bound <= threshold) {
+                if (pivot + 1 < order.size()) {
+                    next_document = std::min(next_document, order[pivot + 1]->cursor.GetDocument());
+                }
+                for (size_t i = 0; i <= pivot; ++i) {
+                    order[i]->cursor.NextGeq(next_document);
+                }
+                restore_order();
+                continue;
+            }
+        }
+
+        if (order[0]->cursor.GetDocument() != pivot_document) {
+            for (size_t i = 0; i < pivot; ++i) {
+                order[i]->cursor.NextGeq(pivot_document);
+            }
+            restore_order();
+            continue;
+        }
+
+        const int ordinal = pivot_document;
+        bool is_excluded = false;
+        for (FrozenIndex::Cursor& minus_cursor : minus_cursors) {
+            minus_cursor.NextGeq(ordinal);
+            if (minus_cursor.IsValid() && minus_cursor.GetDocument() == ordinal) {
+                is_excluded = true;
+                break;
+            }
+        }
+        if (!is_excluded && !query.deleted_documents.Contains(ordinal) && !IsRemoved(ordinal)
+                && document_predicate(document_ids_[ordinal], document_statuses_[ordinal], document_ratings_[ordinal])) {
+            // суммируем в порядке слов запроса, как при полном переборе
+            for (size_t i = 0; i <= pivot; ++i) {
+                relevances[order[i]->term] = order[i]->cursor.GetTermFreq() * order[i]->inverse_document_freq;
+                matched[order[i]->term] = true;
+            }
+            double relevance = 0.0;
+            for (size_t term = 0; term < relevances.size(); ++term) {
+                if (matched[term]) {
+                    relevance += relevances[term];
+                    matched[term] = false;
+                }
+            }
+            top.Add({document_ids_[ordinal], relevance, document_ratings_[ordinal]});
+        }
+        for (size_t i = 0; i <= pivot; ++i) {
+            order[i]->cursor.Next();
+        }
+        restore_order();
+    }
 }
+
 template <class ExecutionPolicy>
 void SearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id){
-    id_list_.erase(document_id);   
-
-    std::vector<std::string_view> words(document_to_word_freqs_[document_id].size());
+    const auto ordinal_it = document_ordinals_.find(document_id);
+    if (ordinal_it == document_ordinals_.end()) {
+        return;
+    }
+    const int ordinal = ordinal_it->second;
+    LogRemoveDocument(document_id);
+    if (!CanRemoveWithoutThaw()) {
+        Thaw();
+    }
+    ++generation_;
+    document_ordinals_.erase(ordinal_it);
 
-    std::transform(policy,
-        document_to_word_freqs_[document_id].begin(),
-        document_to_word_freqs_[document_id].end(),
-        words.begin(),
-        [](const auto &word){
-            return (word.first);
-        }
-    );
+    if (is_frozen_) {
+        RemoveFrozenDocument(ordinal);
+    } else {
+        auto& word_freqs = document_to_word_freqs_[ordinal];
 
-    std::for_each(policy, words.begin(), words.end(),
-        [this, document_id](std::string_view word) {
-            word_to_document_freqs_[word].erase(document_id);
+        // слова документа различны, каждый счётчик меняет один поток
+        std::for_each(policy, word_freqs.begin(), word_freqs.end(),
+            [this](const std::pair<TermId, double>& word_freq) {
+                ++word_to_document_freqs_[word_freq.first].removed_count;
+            }
+        );
+        if (document_tombstones_.size() <= static_cast<size_t>(ordinal)) {
+            document_tombstones_.resize(document_ids_.size());
         }
-    );
+        document_tombstones_[ordinal] = true;
 
-    document_to_word_freqs_.erase(document_id);
+        // освобождаем прямой индекс; номер документа больше не используется
+        std::vector<std::pair<TermId, double>>().swap(word_freqs);
+    }
 
-    documents_.erase(document_id);   
+    if (NeedsCompaction()) {
+        if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>) {
+            Compact(std::execution::seq);
+        } else {
+            Compact(std::execution::par);
+        }
+    }
 }
\ No newline at end of file
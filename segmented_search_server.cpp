@@ -0,0 +1,335 @@
+#include "segmented_search_server.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <unordered_set>
+
+using namespace std;
+
+namespace {
+
+const uint32_t NOT_DELETED = numeric_limits<uint32_t>::max();
+
+}  // namespace
+
+SegmentedSearchServer::SegmentedSearchServer(string_view stop_words_text, SegmentOptions options)
+    : stop_words_text_(stop_words_text)
+    , options_(options)
+    , version_(make_shared<const Version>()) {
+    // стоп-слова проверяются сразу, а не при первом добавлении
+    const SearchServer stop_words_check(stop_words_text_);
+    merge_thread_ = thread([this] {
+        MergeSegments();
+    });
+}
+
+SegmentedSearchServer::~SegmentedSearchServer() {
+    {
+        lock_guard lock(write_mutex_);
+        is_stopping_ = true;
+    }
+    merge_requested_.notify_all();
+    merge_thread_.join();
+}
+
+SegmentedSearchServer::Segment::Segment(SearchServer&& index)
+    : index(move(index))
+    , deleted_ordinals(make_unique<int[]>(GetOrdinalCount()))
+    , deletion_positions(make_unique<atomic<uint32_t>[]>(GetOrdinalCount())) {
+    for (int ordinal = 0; ordinal < GetOrdinalCount(); ++ordinal) {
+        deletion_positions[ordinal].store(NOT_DELETED, memory_order_relaxed);
+    }
+}
+
+int SegmentedSearchServer::Segment::GetOrdinalCount() const {
+    return static_cast<int>(index.document_ids_.size());
+}
+
+int SegmentedSearchServer::Segment::FindLiveOrdinal(int document_id) const {
+    const auto it = index.document_ordinals_.find(document_id);
+    if (it == index.document_ordinals_.end()
+            || deletion_positions[it->second].load(memory_order_relaxed) != NOT_DELETED) {
+        return -1;
+    }
+    return it->second;
+}
+
+void SegmentedSearchServer::Segment::MarkDeleted(int ordinal) {
+    // читатели увидят запись только в версиях, опубликованных после неё
+    deleted_ordinals[deletion_count] = ordinal;
+    deletion_positions[ordinal].store(deletion_count, memory_order_release);
+    ++deletion_count;
+}
+
+SearchServer::DeletedDocuments SegmentedSearchServer::SegmentView::GetDeletedDocuments() const {
+    return {segment->deletion_positions.get(), visible_deletions};
+}
+
+int SegmentedSearchServer::SegmentView::GetLiveCount() const {
+    return segment->GetOrdinalCount() - static_cast<int>(visible_deletions);
+}
+
+size_t SegmentedSearchServer::SegmentView::GetDocumentFreq(TermId term_id) const {
+    const SearchServer::WordPostings postings = segment->index.FindPostings(term_id);
+    size_t document_freq = postings.size();
+    if (visible_deletions == 0 || document_freq == 0) {
+        return document_freq;
+    }
+    // удалённые документы со словом: поиском каждого удалённого в списке
+    // слова или проходом по списку, смотря что дешевле
+    if (visible_deletions * log2(document_freq + 1.0) < document_freq) {
+        for (uint32_t i = 0; i < visible_deletions; ++i) {
+            document_freq -= postings.contains(segment->deleted_ordinals[i]);
+        }
+    } else {
+        const SearchServer::DeletedDocuments deleted_documents = GetDeletedDocuments();
+        postings.ForEach([&document_freq, &deleted_documents](int ordinal, double) {
+            document_freq -= deleted_documents.Contains(ordinal);
+        });
+    }
+    return document_freq;
+}
+
+shared_ptr<const SegmentedSearchServer::Version> SegmentedSearchServer::GetVersion() const {
+    return atomic_load(&version_);
+}
+
+vector<shared_ptr<SegmentedSearchServer::Segment>> SegmentedSearchServer::GetSegments() const {
+    vector<shared_ptr<Segment>> segments;
+    for (const SegmentView& view : GetVersion()->segments) {
+        segments.push_back(view.segment);
+    }
+    return segments;
+}
+
+void SegmentedSearchServer::Publish(vector<shared_ptr<Segment>> segments) {
+    auto version = make_shared<Version>();
+    version->segments.reserve(segments.size());
+    for (shared_ptr<Segment>& segment : segments) {
+        const uint32_t visible_deletions = segment->deletion_count;
+        version->segments.push_back({move(segment), visible_deletions});
+    }
+    atomic_store(&version_, shared_ptr<const Version>(move(version)));
+}
+
+shared_ptr<SegmentedSearchServer::Segment> SegmentedSearchServer::MakeSegment(SearchServer&& index,
+                                                                            bool is_sealed) const {
+    // незапечатанный сегмент скоро будет собран заново, замораживать его незачем
+    if (is_sealed) {
+        index.Freeze(options_.posting_format);
+    }
+    auto segment = make_shared<Segment>(move(index));
+    segment->is_sealed = is_sealed;
+    return segment;
+}
+
+void SegmentedSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status,
+                                        const vector<int>& ratings) {
+    lock_guard lock(write_mutex_);
+    vector<shared_ptr<Segment>> segments = GetSegments();
+    for (const shared_ptr<Segment>& segment : segments) {
+        if (segment->FindLiveOrdinal(document_id) >= 0) {
+            throw invalid_argument("ID exists");
+        }
+    }
+
+    // незапечатанный сегмент собирается заново вместе с новым документом,
+    // удалённые из него документы при этом выбрасываются
+    SearchServer index(stop_words_text_);
+    const bool has_open_segment = !segments.empty() && !segments.back()->is_sealed;
+    if (has_open_segment) {
+        const Segment& open_segment = *segments.back();
+        unordered_set<int> deleted_ids;
+        for (uint32_t i = 0; i < open_segment.deletion_count; ++i) {
+            deleted_ids.insert(open_segment.index.document_ids_[open_segment.deleted_ordinals[i]]);
+        }
+        index.ImportDocuments(open_segment.index, deleted_ids);
+    }
+    index.AddDocument(document_id, document, status, ratings);
+    const bool is_sealed = static_cast<size_t>(index.GetDocumentCount()) >= options_.seal_threshold;
+    shared_ptr<Segment> segment = MakeSegment(move(index), is_sealed);
+    if (has_open_segment) {
+        segments.back() = move(segment);
+    } else {
+        segments.push_back(move(segment));
+    }
+    Publish(move(segments));
+    if (is_sealed) {
+        merge_requested_.notify_one();
+    }
+}
+
+void SegmentedSearchServer::RemoveDocument(int document_id) {
+    lock_guard lock(write_mutex_);
+    vector<shared_ptr<Segment>> segments = GetSegments();
+    for (const shared_ptr<Segment>& segment : segments) {
+        const int ordinal = segment->FindLiveOrdinal(document_id);
+        if (ordinal >= 0) {
+            segment->MarkDeleted(ordinal);
+            Publish(move(segments));
+            merge_requested_.notify_one();
+            return;
+        }
+    }
+}
+
+vector<Document> SegmentedSearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status,
+                                                         size_t top_k) const {
+    return FindTopDocuments(execution::seq, raw_query, status, top_k);
+}
+
+vector<SegmentedSearchServer::SegmentQuery> SegmentedSearchServer::ResolveQuery(const Version& version,
+                                                                                string_view raw_query) {
+    // запрос проверяется и без сегментов: ошибки те же, что у SearchServer
+    const vector<SearchServer::QueryWord> query_words = SearchServer::SplitQueryWords(raw_query);
+
+    // число живых документов со словом по всем сегментам версии
+    vector<SearchServer::Query> queries;
+    queries.reserve(version.segments.size());
+    map<string_view, size_t> document_freqs;
+    int document_count = 0;
+    for (const SegmentView& view : version.segments) {
+        const SearchServer& index = view.segment->index;
+        queries.push_back(index.FindQueryTerms(query_words));
+        for (const TermId term_id : queries.back().plus_terms) {
+            document_freqs[index.dictionary_.GetTerm(term_id)] += view.GetDocumentFreq(term_id);
+        }
+        document_count += view.GetLiveCount();
+    }
+
+    vector<SegmentQuery> segment_queries;
+    segment_queries.reserve(version.segments.size());
+    for (size_t i = 0; i < version.segments.size(); ++i) {
+        const SegmentView& view = version.segments[i];
+        const SearchServer& index = view.segment->index;
+        vector<double> inverse_document_freqs;
+        for (const TermId term_id : queries[i].plus_terms) {
+            const size_t document_freq = document_freqs[index.dictionary_.GetTerm(term_id)];
+            inverse_document_freqs.push_back(document_freq > 0 ? log(document_count * 1.0 / document_freq) : 0.0);
+        }
+        SegmentQuery& segment_query = segment_queries.emplace_back();
+        segment_query.index = &index;
+        segment_query.resolved_query = index.ResolveQuery(queries[i], inverse_document_freqs);
+        segment_query.resolved_query.deleted_documents = view.GetDeletedDocuments();
+    }
+    return segment_queries;
+}
+
+tuple<vector<string>, DocumentStatus> SegmentedSearchServer::MatchDocument(string_view raw_query,
+                                                                           int document_id) const {
+    const shared_ptr<const Version> version = GetVersion();
+    for (const SegmentView& view : version->segments) {
+        const SearchServer& index = view.segment->index;
+        const auto it = index.document_ordinals_.find(document_id);
+        if (it != index.document_ordinals_.end() && !view.GetDeletedDocuments().Contains(it->second)) {
+            const auto [words, status] = index.MatchDocument(raw_query, document_id);
+            return {vector<string>(words.begin(), words.end()), status};
+        }
+    }
+    throw out_of_range("Invalid id");
+}
+
+int SegmentedSearchServer::GetDocumentCount() const {
+    int document_count = 0;
+    for (const SegmentView& view : GetVersion()->segments) {
+        document_count += view.GetLiveCount();
+    }
+    return document_count;
+}
+
+size_t SegmentedSearchServer::GetSegmentCount() const {
+    return GetVersion()->segments.size();
+}
+
+void SegmentedSearchServer::WaitForMerges() {
+    unique_lock lock(write_mutex_);
+    merge_finished_.wait(lock, [this] {
+        const auto [first, last] = FindMerge(GetSegments());
+        return !is_merging_ && first == last;
+    });
+}
+
+size_t SegmentedSearchServer::GetLevel(int live_count) const {
+    size_t level = 0;
+    for (size_t limit = options_.seal_threshold * options_.merge_factor; static_cast<size_t>(live_count) >= limit;
+         limit *= options_.merge_factor) {
+        ++level;
+    }
+    return level;
+}
+
+pair<size_t, size_t> SegmentedSearchServer::FindMerge(const vector<shared_ptr<Segment>>& segments) const {
+    const auto get_level = [this](const Segment& segment) {
+        return GetLevel(segment.GetOrdinalCount() - static_cast<int>(segment.deletion_count));
+    };
+    // сначала сегменты, где удалённых документов слишком много
+    for (size_t i = 0; i < segments.size() && segments[i]->is_sealed; ++i) {
+        if (segments[i]->deletion_count > options_.purge_ratio * segments[i]->GetOrdinalCount()) {
+            return {i, i + 1};
+        }
+    }
+    // затем merge_factor соседних запечатанных сегментов одного уровня
+    size_t run_length = 0;
+    for (size_t i = 0; i < segments.size() && segments[i]->is_sealed; ++i) {
+        run_length = i > 0 && get_level(*segments[i]) == get_level(*segments[i - 1]) ? run_length + 1 : 1;
+        if (run_length == max<size_t>(2, options_.merge_factor)) {
+            return {i + 1 - run_length, i + 1};
+        }
+    }
+    return {0, 0};
+}
+
+void SegmentedSearchServer::MergeSegments() {
+    unique_lock lock(write_mutex_);
+    while (true) {
+        pair<size_t, size_t> merge;
+        merge_requested_.wait(lock, [this, &merge] {
+            merge = FindMerge(GetSegments());
+            return is_stopping_ || merge.first != merge.second;
+        });
+        if (is_stopping_) {
+            return;
+        }
+
+        // сегменты не меняются, кроме журналов удалений: их длины запоминаются
+        // сейчас, а записи, добавленные во время слияния, переносятся после него
+        const vector<shared_ptr<Segment>> segments = GetSegments();
+        const vector<shared_ptr<Segment>> inputs(segments.begin() + merge.first, segments.begin() + merge.second);
+        vector<uint32_t> deletion_counts;
+        for (const shared_ptr<Segment>& input : inputs) {
+            deletion_counts.push_back(input->deletion_count);
+        }
+        is_merging_ = true;
+        lock.unlock();
+
+        SearchServer index(stop_words_text_);
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            unordered_set<int> deleted_ids;
+            for (uint32_t j = 0; j < deletion_counts[i]; ++j) {
+                deleted_ids.insert(inputs[i]->index.document_ids_[inputs[i]->deleted_ordinals[j]]);
+            }
+            index.ImportDocuments(inputs[i]->index, deleted_ids);
+        }
+        shared_ptr<Segment> merged = MakeSegment(move(index), true);
+
+        lock.lock();
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            for (uint32_t j = deletion_counts[i]; j < inputs[i]->deletion_count; ++j) {
+                const int document_id = inputs[i]->index.document_ids_[inputs[i]->deleted_ordinals[j]];
+                merged->MarkDeleted(merged->index.GetOrdinal(document_id));
+            }
+        }
+        // пока шло слияние, новые сегменты могли появиться только после входных
+        vector<shared_ptr<Segment>> current_segments = GetSegments();
+        const auto first = find(current_segments.begin(), current_segments.end(), inputs.front());
+        const auto position = current_segments.erase(first, first + inputs.size());
+        if (merged->GetOrdinalCount() > static_cast<int>(merged->deletion_count)) {
+            current_segments.insert(position, move(merged));
+        }
+        Publish(move(current_segments));
+        is_merging_ = false;
+        merge_finished_.notify_all();
+    }
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "search_server.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+struct SegmentOptions {
+    // число документов, при котором последний сегмент запечатывается
+    size_t seal_threshold = 16;
+    // сколько сегментов одного уровня сливаются в один
+    size_t merge_factor = 4;
+    // доля удалённых документов, при которой сегмент переписывается без них
+    double purge_ratio = 0.25;
+    PostingFormat posting_format = PostingFormat::PLAIN;
+};
+
+// Индекс из неизменяемых сегментов (LSM) с изоляцией снимков.
+// Состояние индекса - версия: список сегментов и для каждого число видимых
+// удалений. Запрос берёт текущую версию и работает только с ней, не ожидая
+// изменений; изменение собирает новую версию и публикует её атомарно.
+// Новые документы попадают в последний небольшой сегмент, который при
+// каждом добавлении собирается заново, пока не наберёт seal_threshold
+// документов. Удаление только дописывает документ в журнал удалений
+// сегмента; фоновый поток сливает сегменты одного уровня размера и
+// выбрасывает удалённые документы. IDF считается по всем живым документам
+// версии, так что релевантность та же, что у одного SearchServer
+class SegmentedSearchServer {
+public:
+    explicit SegmentedSearchServer(std::string_view stop_words_text, SegmentOptions options = {});
+    ~SegmentedSearchServer();
+    SegmentedSearchServer(const SegmentedSearchServer&) = delete;
+    SegmentedSearchServer& operator=(const SegmentedSearchServer&) = delete;
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status,
+                     const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                           DocumentPredicate document_predicate,
+                                           size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                           DocumentStatus status = DocumentStatus::ACTUAL,
+                                           size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
+                                           DocumentStatus status = DocumentStatus::ACTUAL,
+                                           size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    // Слова копируются: сегмент документа может быть заменён слиянием
+    std::tuple<std::vector<std::string>, DocumentStatus> MatchDocument(std::string_view raw_query,
+                                                                       int document_id) const;
+
+    int GetDocumentCount() const;
+    size_t GetSegmentCount() const;
+    // Ждёт, пока не останется слияний, которые нужно сделать
+    void WaitForMerges();
+
+private:
+    struct Segment {
+        explicit Segment(SearchServer&& index);
+
+        // заморожен и не меняется
+        SearchServer index;
+        // журнал удалений: номера удалённых документов по порядку удаления
+        std::unique_ptr<int[]> deleted_ordinals;
+        // позиция документа в журнале удалений, у живых - максимум
+        std::unique_ptr<std::atomic<uint32_t>[]> deletion_positions;
+        // длина журнала; читается и меняется под write_mutex_
+        uint32_t deletion_count = 0;
+        // запечатанный сегмент больше не собирается заново при добавлении
+        bool is_sealed = false;
+
+        int GetOrdinalCount() const;
+        // номер документа, если он есть и не удалён; иначе -1
+        int FindLiveOrdinal(int document_id) const;
+        void MarkDeleted(int ordinal);
+    };
+
+    // Сегмент, каким его видит версия
+    struct SegmentView {
+        std::shared_ptr<Segment> segment;
+        uint32_t visible_deletions;
+
+        SearchServer::DeletedDocuments GetDeletedDocuments() const;
+        int GetLiveCount() const;
+        size_t GetDocumentFreq(TermId term_id) const;
+    };
+
+    struct Version {
+        // от старых к новым; незапечатанный сегмент, если есть, последний
+        std::vector<SegmentView> segments;
+    };
+
+    // Разобранный запрос одного сегмента с IDF по всей версии
+    struct SegmentQuery {
+        const SearchServer* index;
+        SearchServer::ResolvedQuery resolved_query;
+    };
+
+    const std::string stop_words_text_;
+    const SegmentOptions options_;
+
+    // читается и заменяется только через std::atomic_load и std::atomic_store
+    std::shared_ptr<const Version> version_;
+
+    // изменения по одному; под ним же слияние забирает и ставит сегменты
+    std::mutex write_mutex_;
+    std::condition_variable merge_requested_;
+    std::condition_variable merge_finished_;
+    bool is_merging_ = false;
+    bool is_stopping_ = false;
+    std::thread merge_thread_;
+
+    std::shared_ptr<const Version> GetVersion() const;
+    std::vector<std::shared_ptr<Segment>> GetSegments() const;
+    // Публикует версию из segments с текущими длинами журналов удалений
+    void Publish(std::vector<std::shared_ptr<Segment>> segments);
+    std::shared_ptr<Segment> MakeSegment(SearchServer&& index, bool is_sealed) const;
+
+    static std::vector<SegmentQuery> ResolveQuery(const Version& version, std::string_view raw_query);
+
+    // Следующие сливаемые сегменты [first, last); пусто, если сливать нечего
+    std::pair<size_t, size_t> FindMerge(const std::vector<std::shared_ptr<Segment>>& segments) const;
+    size_t GetLevel(int live_count) const;
+    void MergeSegments();
+};
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                                              DocumentPredicate document_predicate,
+                                                              size_t top_k) const {
+    const std::shared_ptr<const Version> version = GetVersion();
+    TopDocuments top(top_k);
+    for (const SegmentQuery& query : ResolveQuery(*version, raw_query)) {
+        for (const Document& document : query.index->RankDocuments(policy, query.resolved_query,
+                                                                    document_predicate, top_k)) {
+            top.Add(document);
+        }
+    }
+    return top.Release();
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                                              DocumentStatus status, size_t top_k) const {
+    return FindTopDocuments(policy, raw_query,
+                            [status](int, DocumentStatus document_status, int) {
+                                return document_status == status;
+                            },
+                            top_k);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(std::string_view raw_query,
+                                                              DocumentPredicate document_predicate,
+                                                              size_t top_k) const {
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate, top_k);
+}
@@ -0,0 +1,161 @@
+#include "sharded_search_server.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+using namespace std;
+
+ShardedSearchServer::ShardedSearchServer(string_view stop_words_text, size_t shard_count) {
+    if (shard_count == 0) {
+        throw invalid_argument("Shard count must be positive"s);
+    }
+    shards_.reserve(shard_count);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.emplace_back(stop_words_text);
+    }
+}
+
+size_t ShardedSearchServer::GetShardIndex(int document_id) const {
+    // перемешивание, чтобы id с общим шагом не попадали в один шард
+    const uint64_t hash = static_cast<uint32_t>(document_id) * 0x9E3779B97F4A7C15ull;
+    return (hash >> 32) % shards_.size();
+}
+
+const SearchServer& ShardedSearchServer::GetShard(int document_id) const {
+    return shards_[GetShardIndex(document_id)];
+}
+
+SearchServer& ShardedSearchServer::GetShard(int document_id) {
+    return shards_[GetShardIndex(document_id)];
+}
+
+void ShardedSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status,
+                                      const vector<int>& ratings) {
+    GetShard(document_id).AddDocument(document_id, document, status, ratings);
+}
+
+vector<exception_ptr> ShardedSearchServer::AddDocuments(const vector<DocumentInput>& documents) {
+    // порядок пакета внутри шарда сохраняется, так что и ошибки те же
+    vector<vector<DocumentInput>> shard_documents(shards_.size());
+    vector<vector<size_t>> shard_positions(shards_.size());
+    for (size_t position = 0; position < documents.size(); ++position) {
+        const size_t shard_index = GetShardIndex(documents[position].id);
+        shard_documents[shard_index].push_back(documents[position]);
+        shard_positions[shard_index].push_back(position);
+    }
+
+    vector<exception_ptr> errors(documents.size());
+    vector<size_t> shard_indexes(shards_.size());
+    iota(shard_indexes.begin(), shard_indexes.end(), 0);
+    for_each(execution::par, shard_indexes.begin(), shard_indexes.end(), [&](size_t shard_index) {
+        const vector<exception_ptr> shard_errors = shards_[shard_index].AddDocuments(execution::seq,
+                                                                                     shard_documents[shard_index]);
+        for (size_t i = 0; i < shard_errors.size(); ++i) {
+            errors[shard_positions[shard_index][i]] = shard_errors[i];
+        }
+    });
+    return errors;
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    RemoveDocument(execution::seq, document_id);
+}
+
+void ShardedSearchServer::RemoveDocuments(const vector<int>& document_ids) {
+    vector<vector<int>> shard_document_ids(shards_.size());
+    for (const int document_id : document_ids) {
+        shard_document_ids[GetShardIndex(document_id)].push_back(document_id);
+    }
+    vector<size_t> shard_indexes(shards_.size());
+    iota(shard_indexes.begin(), shard_indexes.end(), 0);
+    for_each(execution::par, shard_indexes.begin(), shard_indexes.end(), [&](size_t shard_index) {
+        shards_[shard_index].RemoveDocuments(execution::seq, shard_document_ids[shard_index]);
+    });
+}
+
+void ShardedSearchServer::UpdateDocument(int document_id, string_view document, DocumentStatus status,
+                                         const vector<int>& ratings) {
+    GetShard(document_id).UpdateDocument(document_id, document, status, ratings);
+}
+
+void ShardedSearchServer::SetStatus(int document_id, DocumentStatus status) {
+    GetShard(document_id).SetStatus(document_id, status);
+}
+
+void ShardedSearchServer::SetRating(int document_id, const vector<int>& ratings) {
+    GetShard(document_id).SetRating(document_id, ratings);
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status,
+                                                       size_t top_k) const {
+    return FindTopDocuments(execution::par, raw_query, status, top_k);
+}
+
+SearchServer::MatchResult ShardedSearchServer::MatchDocument(string_view raw_query, int document_id) const {
+    return GetShard(document_id).MatchDocument(raw_query, document_id);
+}
+
+map<string_view, double> ShardedSearchServer::GetWordFrequencies(int document_id) const {
+    return GetShard(document_id).GetWordFrequencies(document_id);
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    int document_count = 0;
+    for (const SearchServer& shard : shards_) {
+        document_count += shard.GetDocumentCount();
+    }
+    return document_count;
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+void ShardedSearchServer::Freeze(PostingFormat format) {
+    for_each(execution::par, shards_.begin(), shards_.end(), [format](SearchServer& shard) {
+        shard.Freeze(format);
+    });
+}
+
+void ShardedSearchServer::Compact() {
+    for_each(execution::par, shards_.begin(), shards_.end(), [](SearchServer& shard) {
+        shard.Compact();
+    });
+}
+
+void ShardedSearchServer::SetDynamicPruning(bool enabled) {
+    for (SearchServer& shard : shards_) {
+        shard.SetDynamicPruning(enabled);
+    }
+}
+
+vector<SearchServer::ResolvedQuery> ShardedSearchServer::ResolveQuery(string_view raw_query) const {
+    // запрос разбирается один раз, слова ищутся в словаре каждого шарда
+    const vector<SearchServer::QueryWord> query_words = SearchServer::SplitQueryWords(raw_query);
+
+    // у шардов свои словари, поэтому число документов со словом
+    // складывается по тексту слова
+    vector<SearchServer::Query> queries;
+    queries.reserve(shards_.size());
+    map<string_view, size_t> document_freqs;
+    for (const SearchServer& shard : shards_) {
+        queries.push_back(shard.FindQueryTerms(query_words));
+        for (const TermId term_id : queries.back().plus_terms) {
+            document_freqs[shard.dictionary_.GetTerm(term_id)] += shard.FindPostings(term_id).size();
+        }
+    }
+    const int document_count = GetDocumentCount();
+
+    vector<SearchServer::ResolvedQuery> resolved_queries;
+    resolved_queries.reserve(shards_.size());
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        vector<double> inverse_document_freqs;
+        for (const TermId term_id : queries[i].plus_terms) {
+            const size_t document_freq = document_freqs[shards_[i].dictionary_.GetTerm(term_id)];
+            inverse_document_freqs.push_back(document_freq > 0 ? log(document_count * 1.0 / document_freq) : 0.0);
+        }
+        resolved_queries.push_back(shards_[i].ResolveQuery(queries[i], inverse_document_freqs));
+    }
+    return resolved_queries;
+}
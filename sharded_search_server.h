@@ -0,0 +1,129 @@
+#pragma once
+
+#include "search_server.h"
+
+#include <exception>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Документы делятся между shard_count независимыми SearchServer по хешу id.
+// Изменения документа и сопоставление идут в шард документа, поиск - во все
+// шарды сразу с IDF по всем документам, так что релевантность та же, что у
+// одного SearchServer. Запросы без политики выполняются параллельно по шардам.
+// Как и SearchServer, изменения нельзя выполнять одновременно с запросами
+class ShardedSearchServer {
+public:
+    ShardedSearchServer(std::string_view stop_words_text, size_t shard_count);
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status,
+                     const std::vector<int>& ratings);
+    // Пакет делится по шардам, шарды заполняются параллельно.
+    // Ошибки те же, что у SearchServer::AddDocuments, в порядке пакета
+    std::vector<std::exception_ptr> AddDocuments(const std::vector<DocumentInput>& documents);
+
+    template <typename ExecutionPolicy>
+    void RemoveDocument(ExecutionPolicy&& policy, int document_id);
+    void RemoveDocument(int document_id);
+    // Пакет делится по шардам, шарды чистятся параллельно
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+    void UpdateDocument(int document_id, std::string_view document, DocumentStatus status,
+                        const std::vector<int>& ratings);
+    void SetStatus(int document_id, DocumentStatus status);
+    void SetRating(int document_id, const std::vector<int>& ratings);
+
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                           DocumentPredicate document_predicate,
+                                           size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                           DocumentStatus status = DocumentStatus::ACTUAL,
+                                           size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
+                                           DocumentStatus status = DocumentStatus::ACTUAL,
+                                           size_t top_k = MAX_RESULT_DOCUMENT_COUNT) const;
+
+    template <typename ExecutionPolicy>
+    SearchServer::MatchResult MatchDocument(ExecutionPolicy&& policy, std::string_view raw_query,
+                                            int document_id) const;
+    SearchServer::MatchResult MatchDocument(std::string_view raw_query, int document_id) const;
+
+    std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
+    int GetDocumentCount() const;
+    size_t GetShardCount() const;
+
+    // Замораживает все шарды параллельно. Квантованных весов нет: они
+    // посчитаны с IDF шарда, а не всего индекса
+    void Freeze(PostingFormat format = PostingFormat::PLAIN);
+    void SetDynamicPruning(bool enabled);
+    // Сборка мусора после удалений во всех шардах параллельно
+    void Compact();
+
+private:
+    std::vector<SearchServer> shards_;
+
+    size_t GetShardIndex(int document_id) const;
+    const SearchServer& GetShard(int document_id) const;
+    SearchServer& GetShard(int document_id);
+
+    // Запрос, разобранный каждым шардом, с IDF по всем шардам
+    std::vector<SearchServer::ResolvedQuery> ResolveQuery(std::string_view raw_query) const;
+};
+
+template <typename ExecutionPolicy>
+void ShardedSearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id) {
+    GetShard(document_id).RemoveDocument(policy, document_id);
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                                            DocumentPredicate document_predicate,
+                                                            size_t top_k) const {
+    const std::vector<SearchServer::ResolvedQuery> resolved_queries = ResolveQuery(raw_query);
+    // каждый шард отбирает свои top_k последовательно, шарды - по политике
+    std::vector<std::vector<Document>> shard_tops(shards_.size());
+    std::vector<size_t> shard_indexes(shards_.size());
+    std::iota(shard_indexes.begin(), shard_indexes.end(), 0);
+    std::for_each(policy, shard_indexes.begin(), shard_indexes.end(), [&](size_t shard_index) {
+        shard_tops[shard_index] = shards_[shard_index].RankDocuments(std::execution::seq,
+                                                                     resolved_queries[shard_index],
+                                                                     document_predicate, top_k);
+    });
+
+    TopDocuments top(top_k);
+    for (const std::vector<Document>& shard_top : shard_tops) {
+        for (const Document& document : shard_top) {
+            top.Add(document);
+        }
+    }
+    return top.Release();
+}
+
+template <typename ExecutionPolicy>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
+                                                            DocumentStatus status, size_t top_k) const {
+    return FindTopDocuments(policy, raw_query,
+                            [status](int, DocumentStatus document_status, int) {
+                                return document_status == status;
+                            },
+                            top_k);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query,
+                                                            DocumentPredicate document_predicate,
+                                                            size_t top_k) const {
+    return FindTopDocuments(std::execution::par, raw_query, document_predicate, top_k);
+}
+
+template <typename ExecutionPolicy>
+SearchServer::MatchResult ShardedSearchServer::MatchDocument(ExecutionPolicy&& policy, std::string_view raw_query,
+                                                             int document_id) const {
+    return GetShard(document_id).MatchDocument(policy, raw_query, document_id);
+}
@@ -0,0 +1,179 @@
+#include "snapshot.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const char SNAPSHOT_MAGIC[8] = {'S', 'R', 'C', 'H', 'S', 'N', 'A', 'P'};
+const size_t FLUSH_SIZE = 1 << 20;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t payload_size;
+    uint64_t checksum;
+};
+
+uint64_t RotateLeft(uint64_t value, int shift) {
+    return (value << shift) | (value >> (64 - shift));
+}
+
+}  // namespace
+
+void SnapshotChecksum::Update(const char* data, size_t size) {
+    for (size_t i = 0; i < size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        state_ = RotateLeft(state_ ^ (word * 0x87C37B91114253D5ull), 27) * 0x4CF5AD432745937Full + 0x52DCE729;
+    }
+}
+
+void SyncFile(const string& path) {
+    const int descriptor = open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        throw runtime_error("Cannot open file");
+    }
+    const bool is_synced = fsync(descriptor) == 0;
+    close(descriptor);
+    if (!is_synced) {
+        throw runtime_error("Cannot sync file");
+    }
+}
+
+void SyncParentDirectory(const string& path) {
+    const size_t slash = path.rfind('/');
+    const string directory = slash == string::npos ? string(".") : path.substr(0, max<size_t>(slash, 1));
+    SyncFile(directory);
+}
+
+MappedFile::MappedFile(const string& path) {
+    const int descriptor = open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        throw runtime_error("Cannot open file");
+    }
+    struct stat file_stat;
+    if (fstat(descriptor, &file_stat) != 0) {
+        close(descriptor);
+        throw runtime_error("Cannot open file");
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    if (size_ > 0) {
+        void* const address = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (address == MAP_FAILED) {
+            close(descriptor);
+            throw runtime_error("Cannot map file");
+        }
+        data_ = static_cast<const char*>(address);
+    }
+    // отображение остаётся действительным и после закрытия файла
+    close(descriptor);
+}
+
+MappedFile::~MappedFile() {
+    if (data_ != nullptr) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+SnapshotWriter::SnapshotWriter(const string& path)
+    : path_(path)
+    , temporary_path_(path + ".tmp")
+    , out_(temporary_path_, ios::binary | ios::trunc) {
+    if (!out_) {
+        throw runtime_error("Cannot write snapshot");
+    }
+    // заголовок записывается в Finish(), когда известна контрольная сумма
+    const SnapshotHeader header{};
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    buffer_.reserve(FLUSH_SIZE + 8);
+}
+
+void SnapshotWriter::WriteBytes(const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        const size_t chunk = min(size, FLUSH_SIZE + 8 - buffer_.size());
+        buffer_.insert(buffer_.end(), bytes, bytes + chunk);
+        bytes += chunk;
+        size -= chunk;
+        payload_size_ += chunk;
+        if (buffer_.size() >= FLUSH_SIZE) {
+            Flush(false);
+        }
+    }
+}
+
+void SnapshotWriter::EndArray() {
+    static const char zeros[8] = {};
+    WriteBytes(zeros, (8 - payload_size_ % 8) % 8);
+}
+
+void SnapshotWriter::Flush(bool is_final) {
+    // в сумму идут только целые 8-байтные слова, остаток ждёт следующих данных
+    const size_t size = is_final ? buffer_.size() : buffer_.size() / 8 * 8;
+    checksum_.Update(buffer_.data(), size);
+    out_.write(buffer_.data(), size);
+    buffer_.erase(buffer_.begin(), buffer_.begin() + size);
+}
+
+void SnapshotWriter::Finish() {
+    EndArray();
+    Flush(true);
+    SnapshotHeader header{};
+    copy(begin(SNAPSHOT_MAGIC), end(SNAPSHOT_MAGIC), header.magic);
+    header.version = SNAPSHOT_VERSION;
+    header.payload_size = payload_size_;
+    header.checksum = checksum_.Get();
+    out_.seekp(0);
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out_.close();
+    if (!out_) {
+        throw runtime_error("Cannot write snapshot");
+    }
+    // иначе после сбоя питания на месте снимка может оказаться пустой файл
+    SyncFile(temporary_path_);
+    if (rename(temporary_path_.c_str(), path_.c_str()) != 0) {
+        throw runtime_error("Cannot write snapshot");
+    }
+    SyncParentDirectory(path_);
+}
+
+SnapshotReader::SnapshotReader(const MappedFile& file) {
+    Check(file.size() >= sizeof(SnapshotHeader));
+    SnapshotHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    Check(equal(begin(SNAPSHOT_MAGIC), end(SNAPSHOT_MAGIC), header.magic));
+    if (header.version != SNAPSHOT_VERSION) {
+        throw runtime_error("Unsupported snapshot version");
+    }
+    Check(header.payload_size == file.size() - sizeof(header) && header.payload_size % 8 == 0);
+    data_ = file.data() + sizeof(header);
+    size_ = header.payload_size;
+    SnapshotChecksum checksum;
+    checksum.Update(data_, size_);
+    if (checksum.Get() != header.checksum) {
+        throw runtime_error("Snapshot checksum mismatch");
+    }
+}
+
+void SnapshotReader::Check(bool condition) {
+    if (!condition) {
+        throw runtime_error("Snapshot is corrupted");
+    }
+}
+
+const char* SnapshotReader::Take(size_t size) {
+    const size_t padded_size = (size + 7) / 8 * 8;
+    Check(padded_size >= size && padded_size <= size_ - position_);
+    const char* const data = data_ + position_;
+    position_ += padded_size;
+    return data;
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "frozen_array.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Снимок индекса: заголовок (сигнатура, версия, размер и контрольная сумма
+// данных) и последовательность значений и массивов. Каждый массив - число
+// элементов и сами элементы; всё выровнено на 8 байт, поэтому при чтении
+// из отображённого файла массивы используются на месте, без копирования
+
+// 2: LSN журнала изменений в начале данных
+const uint32_t SNAPSHOT_VERSION = 2;
+
+// Контрольная сумма по 8-байтным словам; защищает от повреждения, не от подделки
+class SnapshotChecksum {
+public:
+    // size кратен 8
+    void Update(const char* data, size_t size);
+    uint64_t Get() const {
+        return state_;
+    }
+
+private:
+    uint64_t state_ = 0x6A09E667F3BCC908ull;
+};
+
+// Файл, отображённый в память только для чтения
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const {
+        return data_;
+    }
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Сбрасывает на диск содержимое файла; runtime_error при ошибке
+void SyncFile(const std::string& path);
+// Сбрасывает на диск каталог файла path: без этого переименование или
+// создание файла может не пережить отключение питания
+void SyncParentDirectory(const std::string& path);
+
+// Пишет снимок во временный файл; Finish() дописывает заголовок,
+// сбрасывает файл на диск и атомарно заменяет им файл path
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string& path);
+
+    template <typename T>
+    void WriteValue(const T& value);
+    template <typename T>
+    void WriteArray(const T* data, size_t count);
+    template <typename T>
+    void WriteArray(const std::vector<T>& values) {
+        WriteArray(values.data(), values.size());
+    }
+    template <typename T>
+    void WriteArray(const FrozenArray<T>& values) {
+        WriteArray(values.data(), values.size());
+    }
+
+    // Массив по частям: BeginArray, затем Append на count элементов, затем EndArray
+    template <typename T>
+    void BeginArray(size_t count);
+    template <typename T>
+    void Append(const T* data, size_t count);
+    void EndArray();
+
+    void Finish();
+
+private:
+    std::string path_;
+    std::string temporary_path_;
+    std::ofstream out_;
+    SnapshotChecksum checksum_;
+    uint64_t payload_size_ = 0;
+    std::vector<char> buffer_;
+
+    void WriteBytes(const void* data, size_t size);
+    void Flush(bool is_final);
+};
+
+// Чтение данных снимка; проверяет заголовок и контрольную сумму
+class SnapshotReader {
+public:
+    // file должен жить, пока используются прочитанные массивы
+    explicit SnapshotReader(const MappedFile& file);
+
+    template <typename T>
+    T ReadValue();
+    // Массив на месте в отображённом файле
+    template <typename T>
+    FrozenArray<T> ReadArray();
+    template <typename T>
+    std::vector<T> ReadVector() {
+        const FrozenArray<T> values = ReadArray<T>();
+        return std::vector<T>(values.begin(), values.end());
+    }
+
+    // Бросает исключение о повреждённом снимке, если condition ложно
+    static void Check(bool condition);
+
+private:
+    const char* data_;
+    size_t size_;
+    size_t position_ = 0;
+
+    const char* Take(size_t size);
+};
+
+template <typename T>
+void SnapshotWriter::WriteValue(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    WriteBytes(&value, sizeof(T));
+    EndArray();
+}
+
+template <typename T>
+void SnapshotWriter::WriteArray(const T* data, size_t count) {
+    BeginArray<T>(count);
+    Append(data, count);
+    EndArray();
+}
+
+template <typename T>
+void SnapshotWriter::BeginArray(size_t count) {
+    static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= 8);
+    const uint64_t stored_count = count;
+    WriteBytes(&stored_count, sizeof(stored_count));
+}
+
+template <typename T>
+void SnapshotWriter::Append(const T* data, size_t count) {
+    WriteBytes(data, count * sizeof(T));
+}
+
+template <typename T>
+T SnapshotReader::ReadValue() {
+    static_assert(std::is_trivially_copyable_v<T>);
+    T value;
+    std::memcpy(&value, Take(sizeof(T)), sizeof(T));
+    return value;
+}
+
+template <typename T>
+FrozenArray<T> SnapshotReader::ReadArray() {
+    static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= 8);
+    const auto count = ReadValue<uint64_t>();
+    Check(count <= (size_ - position_) / sizeof(T));
+    return FrozenArray<T>::View(reinterpret_cast<const T*>(Take(count * sizeof(T))), count);
+}
@@ -1,17 +1,159 @@
 #include "string_processing.h"
 #include <cstdint>
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define STRING_PROCESSING_X86 1
+#endif
+
 using namespace std;
 
-vector<string_view> SplitIntoWords(string_view text) {
-    vector<string_view> result;
-    text.remove_prefix(min(text.size(), text.find_first_not_of(' ')));
-    const int64_t pos_end = text.npos;
+namespace {
+
+const size_t NO_WORD = static_cast<size_t>(-1);
+
+// Текст разбирается кусками до 64 байт: бит i маски - байт first + i.
+// word_start - начало незаконченного слова или NO_WORD
+class WordScanner {
+public:
+    WordScanner(string_view text, vector<string_view>& words)
+        : text_(text)
+        , words_(words) {
+        words_.clear();
+    }
+
+    void AddChunk(size_t first, uint64_t spaces, size_t width) {
+        uint64_t non_spaces = ~spaces & (width == 64 ? ~uint64_t{0} : (uint64_t{1} << width) - 1);
+        // чередуем поиск начала и конца слова; биты до найденного сбрасываются
+        while (true) {
+            if (word_start_ == NO_WORD) {
+                if (non_spaces == 0) {
+                    return;
+                }
+                const int position = __builtin_ctzll(non_spaces);
+                word_start_ = first + position;
+                spaces &= ~((uint64_t{2} << position) - 1);
+            } else {
+                if (spaces == 0) {
+                    return;
+                }
+                const int position = __builtin_ctzll(spaces);
+                words_.push_back(text_.substr(word_start_, first + position - word_start_));
+                word_start_ = NO_WORD;
+                non_spaces &= ~((uint64_t{2} << position) - 1);
+            }
+        }
+    }
+
+    // Скалярный разбор [first, text.size()); false - встретился управляющий символ
+    bool AddTail(size_t first, bool validate) {
+        for (; first < text_.size(); first += 64) {
+            const size_t width = min<size_t>(64, text_.size() - first);
+            uint64_t spaces = 0;
+            for (size_t i = 0; i < width; ++i) {
+                const char c = text_[first + i];
+                if (validate && c >= '\0' && c < ' ') {
+                    return false;
+                }
+                spaces |= static_cast<uint64_t>(c == ' ') << i;
+            }
+            AddChunk(first, spaces, width);
+        }
+        return true;
+    }
+
+    void Finish() {
+        if (word_start_ != NO_WORD) {
+            words_.push_back(text_.substr(word_start_));
+        }
+    }
+
+    string_view GetText() const {
+        return text_;
+    }
 
-    while (!text.empty()) {
-        int64_t space = text.find(' ');
-        result.push_back(space == pos_end ? text : text.substr(0, space));
-        text.remove_prefix(min(text.size(), text.find_first_not_of(' ', space)));
+private:
+    string_view text_;
+    vector<string_view>& words_;
+    size_t word_start_ = NO_WORD;
+};
+
+#ifdef STRING_PROCESSING_X86
+// Возвращают позицию, с которой продолжать, или NO_WORD при управляющем символе
+__attribute__((target("avx2")))
+size_t ScanAvx2(WordScanner& scanner, size_t first, bool validate) {
+    const string_view text = scanner.GetText();
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i minus_one = _mm256_set1_epi8(-1);
+    for (; first + 32 <= text.size(); first += 32) {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text.data() + first));
+        if (validate) {
+            // 0 <= c < 32 в знаковом сравнении; байты UTF-8 отрицательны
+            const __m256i control = _mm256_and_si256(_mm256_cmpgt_epi8(space, bytes),
+                                                     _mm256_cmpgt_epi8(bytes, minus_one));
+            if (!_mm256_testz_si256(control, control)) {
+                return NO_WORD;
+            }
+        }
+        const auto spaces = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, space)));
+        scanner.AddChunk(first, spaces, 32);
+    }
+    return first;
+}
+
+size_t ScanSse2(WordScanner& scanner, size_t first, bool validate) {
+    const string_view text = scanner.GetText();
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i minus_one = _mm_set1_epi8(-1);
+    for (; first + 16 <= text.size(); first += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + first));
+        if (validate) {
+            const __m128i control = _mm_and_si128(_mm_cmpgt_epi8(space, bytes), _mm_cmpgt_epi8(bytes, minus_one));
+            if (_mm_movemask_epi8(control) != 0) {
+                return NO_WORD;
+            }
+        }
+        const auto spaces = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, space)));
+        scanner.AddChunk(first, spaces, 16);
+    }
+    return first;
+}
+
+bool HasAvx2() {
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+}
+#endif
+
+bool Split(string_view text, vector<string_view>& words, bool validate) {
+    WordScanner scanner(text, words);
+    size_t first = 0;
+#ifdef STRING_PROCESSING_X86
+    if (HasAvx2()) {
+        first = ScanAvx2(scanner, first, validate);
+    }
+    if (first != NO_WORD) {
+        first = ScanSse2(scanner, first, validate);
     }
+    if (first == NO_WORD) {
+        return false;
+    }
+#endif
+    if (!scanner.AddTail(first, validate)) {
+        return false;
+    }
+    scanner.Finish();
+    return true;
+}
+
+}  // namespace
+
+vector<string_view> SplitIntoWords(string_view text) {
+    vector<string_view> result;
+    Split(text, result, false);
     return result;
+}
+
+bool SplitIntoValidWords(string_view text, vector<string_view>& words) {
+    return Split(text, words, true);
 }
\ No newline at end of file
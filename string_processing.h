@@ -5,6 +5,12 @@
 
 std::vector<std::string_view> SplitIntoWords(std::string_view text);
 
+// Разбивает text на слова по пробелам за один проход, заодно проверяя, что
+// в тексте нет управляющих символов [0, 32). Слова пишутся в words, прежнее
+// содержимое удаляется, память буфера переиспользуется. При управляющем
+// символе возвращает false, содержимое words тогда не определено
+[[nodiscard]] bool SplitIntoValidWords(std::string_view text, std::vector<std::string_view>& words);
+
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
     std::set<std::string, std::less<>> non_empty_strings;
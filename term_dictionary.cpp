@@ -0,0 +1,66 @@
+#include "term_dictionary.h"
+
+#include <algorithm>
+#include <functional>
+
+using namespace std;
+
+TermId TermDictionary::Add(string_view term) {
+    if ((terms_.size() + 1) * 2 > slots_.size()) {
+        Rehash(max<size_t>(16, slots_.size() * 2));
+    }
+    const size_t hash = std::hash<string_view>{}(term);
+    const size_t slot = FindSlot(term, hash);
+    if (slots_[slot] != npos) {
+        return slots_[slot];
+    }
+    const auto term_id = static_cast<TermId>(terms_.size());
+    terms_.push_back(StoreInArena(term));
+    hashes_.push_back(hash);
+    slots_[slot] = term_id;
+    return term_id;
+}
+
+TermId TermDictionary::Find(string_view term) const {
+    if (slots_.empty()) {
+        return npos;
+    }
+    return slots_[FindSlot(term, std::hash<string_view>{}(term))];
+}
+
+size_t TermDictionary::FindSlot(string_view term, size_t hash) const {
+    const size_t mask = slots_.size() - 1;
+    size_t slot = hash & mask;
+    while (slots_[slot] != npos
+           && (hashes_[slots_[slot]] != hash || terms_[slots_[slot]] != term)) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void TermDictionary::Rehash(size_t slot_count) {
+    slots_.assign(slot_count, npos);
+    const size_t mask = slot_count - 1;
+    for (TermId term_id = 0; term_id < terms_.size(); ++term_id) {
+        size_t slot = hashes_[term_id] & mask;
+        while (slots_[slot] != npos) {
+            slot = (slot + 1) & mask;
+        }
+        slots_[slot] = term_id;
+    }
+}
+
+string_view TermDictionary::StoreInArena(string_view term) {
+    if (term.size() > arena_free_) {
+        // длинное слово получает собственный кусок
+        const size_t chunk_size = max(ARENA_CHUNK_SIZE, term.size());
+        arena_chunks_.push_back(make_unique<char[]>(chunk_size));
+        arena_position_ = arena_chunks_.back().get();
+        arena_free_ = chunk_size;
+    }
+    char* const position = arena_position_;
+    copy(term.begin(), term.end(), position);
+    arena_position_ += term.size();
+    arena_free_ -= term.size();
+    return {position, term.size()};
+}
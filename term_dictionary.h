@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+using TermId = uint32_t;
+
+// Словарь слов индекса: каждое слово получает номер TermId, номера
+// выдаются подряд с нуля. Байты слов хранятся в арене из крупных кусков,
+// которые не перемещаются, поэтому string_view из GetTerm действительны
+// всё время жизни словаря. Поиск - одна проба в хеш-таблице
+// с открытой адресацией
+class TermDictionary {
+public:
+    static constexpr TermId npos = std::numeric_limits<TermId>::max();
+
+    // Номер слова; новое слово добавляется в словарь
+    TermId Add(std::string_view term);
+    // Номер слова или npos, если слова нет
+    TermId Find(std::string_view term) const;
+
+    std::string_view GetTerm(TermId term_id) const {
+        return terms_[term_id];
+    }
+    size_t size() const {
+        return terms_.size();
+    }
+
+private:
+    static constexpr size_t ARENA_CHUNK_SIZE = 1 << 16;
+
+    std::vector<std::unique_ptr<char[]>> arena_chunks_;
+    char* arena_position_ = nullptr;
+    size_t arena_free_ = 0;
+
+    std::vector<std::string_view> terms_;
+    std::vector<size_t> hashes_;
+    // номера слов по хешу, npos - свободная ячейка; заполнено не больше половины
+    std::vector<TermId> slots_;
+
+    size_t FindSlot(std::string_view term, size_t hash) const;
+    void Rehash(size_t slot_count);
+    std::string_view StoreInArena(std::string_view term);
+};
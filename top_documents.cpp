@@ -0,0 +1,38 @@
+#include "top_documents.h"
+
+#include <cmath>
+
+using namespace std;
+
+bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (abs(lhs.relevance - rhs.relevance) < COMPARE_TOLERANCE) {
+        return lhs.rating > rhs.rating;
+    } else {
+        return lhs.relevance > rhs.relevance;
+    }
+}
+
+void TopDocuments::Merge(const TopDocuments& other) {
+    for (const Document& document : other.heap_) {
+        Add(document);
+    }
+}
+
+vector<Document> TopDocuments::Release() {
+    sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    vector<Document> result;
+    result.swap(heap_);
+    return result;
+}
+
+void TopDocuments::AppendTo(vector<Document>& out) {
+    sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    out.insert(out.end(), heap_.begin(), heap_.end());
+    heap_.clear();
+}
+
+void TopDocuments::MoveTo(Document* out) {
+    sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    copy(heap_.begin(), heap_.end(), out);
+    heap_.clear();
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "document.h"
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+const double COMPARE_TOLERANCE = 1e-6;
+const int MAX_RESULT_DOCUMENT_COUNT = 5;
+
+bool IsMoreRelevant(const Document& lhs, const Document& rhs);
+
+// Ограниченная куча из top_k лучших документов, на вершине худший из них.
+// Отбор k из n стоит O(n log k) вместо полной сортировки
+class TopDocuments {
+public:
+    explicit TopDocuments(size_t top_k)
+        : top_k_(top_k) {
+        heap_.reserve(top_k_);
+    }
+
+    void Add(const Document& document) {
+        if (heap_.size() < top_k_) {
+            heap_.push_back(document);
+            std::push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        } else if (top_k_ > 0 && IsMoreRelevant(document, heap_.front())) {
+            std::pop_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+            heap_.back() = document;
+            std::push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        }
+    }
+
+    void Merge(const TopDocuments& other);
+
+    size_t GetSize() const {
+        return heap_.size();
+    }
+    bool IsFull() const {
+        return top_k_ > 0 && heap_.size() == top_k_;
+    }
+    // Худший из отобранных, вызывать только для непустой кучи
+    const Document& GetWorst() const {
+        return heap_.front();
+    }
+
+    // Результат по убыванию релевантности; сама куча после вызова пуста
+    std::vector<Document> Release();
+    // Дописывает результат по убыванию релевантности в out; куча пуста,
+    // но сохраняет память для следующего запроса
+    void AppendTo(std::vector<Document>& out);
+    // То же в out[0, GetSize())
+    void MoveTo(Document* out);
+    // Пустая куча для нового запроса
+    void Reset(size_t top_k) {
+        top_k_ = top_k;
+        heap_.clear();
+        heap_.reserve(top_k_);
+    }
+
+private:
+    size_t top_k_;
+    std::vector<Document> heap_;
+};
@@ -0,0 +1,439 @@
+#include "write_ahead_log.h"
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// Последний символ - версия формата. Версия 2 добавила записи
+// UPDATE_DOCUMENT, SET_STATUS и SET_RATING; журнал версии 1 читается
+// и при открытии получает заголовок версии 2, чтобы прежняя программа
+// не приняла новые записи за оборванный хвост
+const char LOG_MAGIC[8] = {'S', 'R', 'C', 'H', 'W', 'A', 'L', '2'};
+const char LOG_MAGIC_V1[8] = {'S', 'R', 'C', 'H', 'W', 'A', 'L', '1'};
+
+struct LogHeader {
+    char magic[8];
+    uint64_t base_lsn;
+};
+
+// контрольная сумма покрывает всё после своего поля, включая выравнивание
+struct RecordHeader {
+    uint64_t checksum;
+    uint32_t payload_size;
+    uint32_t type;
+    uint64_t lsn;
+};
+
+size_t PadTo8(size_t size) {
+    return (size + 7) / 8 * 8;
+}
+
+template <typename T>
+void AppendValue(vector<char>& out, const T& value) {
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+void WriteAll(int descriptor, const char* data, size_t size) {
+    while (size > 0) {
+        const ssize_t written = write(descriptor, data, size);
+        if (written < 0) {
+            throw runtime_error("Cannot write log");
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+
+void SyncDescriptor(int descriptor) {
+    if (fdatasync(descriptor) != 0) {
+        throw runtime_error("Cannot sync log");
+    }
+}
+
+}  // namespace
+
+WriteAheadLog::WriteAheadLog(const string& path, LogSyncPolicy sync_policy, chrono::milliseconds sync_interval)
+    : path_(path)
+    , sync_policy_(sync_policy) {
+    Open();
+    if (sync_policy_ == LogSyncPolicy::PERIODIC) {
+        sync_thread_ = thread([this, sync_interval] {
+            SyncPeriodically(sync_interval);
+        });
+    }
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    if (sync_thread_.joinable()) {
+        {
+            lock_guard lock(mutex_);
+            is_stopping_ = true;
+        }
+        stop_requested_.notify_all();
+        sync_thread_.join();
+    }
+    try {
+        Flush(last_lsn_, sync_policy_ != LogSyncPolicy::NONE);
+    } catch (const exception&) {
+        // деструктор не бросает; записи без Commit не подтверждались
+    }
+    close(descriptor_);
+}
+
+void WriteAheadLog::Open() {
+    descriptor_ = open(path_.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (descriptor_ < 0) {
+        throw runtime_error("Cannot open log");
+    }
+    struct stat file_stat;
+    if (fstat(descriptor_, &file_stat) != 0) {
+        close(descriptor_);
+        throw runtime_error("Cannot open log");
+    }
+    if (file_stat.st_size == 0) {
+        LogHeader header{};
+        copy(begin(LOG_MAGIC), end(LOG_MAGIC), header.magic);
+        try {
+            WriteAll(descriptor_, reinterpret_cast<const char*>(&header), sizeof(header));
+            SyncDescriptor(descriptor_);
+            // новый файл должен остаться в каталоге после сбоя питания
+            SyncParentDirectory(path_);
+        } catch (...) {
+            close(descriptor_);
+            throw;
+        }
+        return;
+    }
+
+    // номер последней целой записи; оборванный хвост отрезается
+    try {
+        const MappedFile file(path_);
+        const char* const end = file.data() + file.size();
+        const char* position = ReadHeader(file.data(), file.size(), last_lsn_);
+        LogRecord record;
+        while (ReadRecord(position, end, last_lsn_, record)) {
+            last_lsn_ = record.lsn;
+        }
+        if (position != end && ftruncate(descriptor_, position - file.data()) != 0) {
+            throw runtime_error("Cannot open log");
+        }
+        if (!equal(LOG_MAGIC, LOG_MAGIC + sizeof(LOG_MAGIC), file.data())) {
+            // дескриптор журнала открыт с O_APPEND, pwrite через него дописал бы в конец
+            const int descriptor = open(path_.c_str(), O_WRONLY);
+            if (descriptor < 0) {
+                throw runtime_error("Cannot open log");
+            }
+            const bool is_upgraded = pwrite(descriptor, LOG_MAGIC, sizeof(LOG_MAGIC), 0)
+                                     == static_cast<ssize_t>(sizeof(LOG_MAGIC))
+                                     && fdatasync(descriptor) == 0;
+            close(descriptor);
+            if (!is_upgraded) {
+                throw runtime_error("Cannot open log");
+            }
+        }
+    } catch (...) {
+        close(descriptor_);
+        throw;
+    }
+    written_lsn_ = last_lsn_;
+    synced_lsn_ = last_lsn_;
+}
+
+uint64_t WriteAheadLog::AppendAddDocument(int document_id, string_view document, DocumentStatus status,
+                                          const vector<int>& ratings) {
+    return AppendDocument(LogRecordType::ADD_DOCUMENT, document_id, document, status, ratings);
+}
+
+uint64_t WriteAheadLog::AppendUpdateDocument(int document_id, string_view document, DocumentStatus status,
+                                             const vector<int>& ratings) {
+    return AppendDocument(LogRecordType::UPDATE_DOCUMENT, document_id, document, status, ratings);
+}
+
+uint64_t WriteAheadLog::AppendDocument(LogRecordType type, int document_id, string_view document,
+                                       DocumentStatus status, const vector<int>& ratings) {
+    vector<char> payload;
+    payload.reserve(4 * sizeof(uint32_t) + ratings.size() * sizeof(int) + document.size());
+    AppendValue(payload, document_id);
+    AppendValue(payload, static_cast<uint32_t>(status));
+    AppendValue(payload, static_cast<uint32_t>(ratings.size()));
+    AppendValue(payload, static_cast<uint32_t>(document.size()));
+    for (const int rating : ratings) {
+        AppendValue(payload, rating);
+    }
+    payload.insert(payload.end(), document.begin(), document.end());
+    return AppendRecord(type, payload);
+}
+
+uint64_t WriteAheadLog::AppendRemoveDocument(int document_id) {
+    vector<char> payload;
+    AppendValue(payload, document_id);
+    return AppendRecord(LogRecordType::REMOVE_DOCUMENT, payload);
+}
+
+uint64_t WriteAheadLog::AppendSetStatus(int document_id, DocumentStatus status) {
+    vector<char> payload;
+    AppendValue(payload, document_id);
+    AppendValue(payload, static_cast<uint32_t>(status));
+    return AppendRecord(LogRecordType::SET_STATUS, payload);
+}
+
+uint64_t WriteAheadLog::AppendSetRating(int document_id, const vector<int>& ratings) {
+    vector<char> payload;
+    payload.reserve(sizeof(int) + sizeof(uint32_t) + ratings.size() * sizeof(int));
+    AppendValue(payload, document_id);
+    AppendValue(payload, static_cast<uint32_t>(ratings.size()));
+    for (const int rating : ratings) {
+        AppendValue(payload, rating);
+    }
+    return AppendRecord(LogRecordType::SET_RATING, payload);
+}
+
+uint64_t WriteAheadLog::AppendRecord(LogRecordType type, const vector<char>& payload) {
+    vector<char> record(sizeof(RecordHeader) + PadTo8(payload.size()));
+    copy(payload.begin(), payload.end(), record.begin() + sizeof(RecordHeader));
+
+    lock_guard lock(mutex_);
+    if (is_failed_) {
+        throw runtime_error("Log failed on an earlier write");
+    }
+    RecordHeader header{0, static_cast<uint32_t>(payload.size()), static_cast<uint32_t>(type), ++last_lsn_};
+    memcpy(record.data(), &header, sizeof(header));
+    SnapshotChecksum checksum;
+    checksum.Update(record.data() + sizeof(header.checksum), record.size() - sizeof(header.checksum));
+    header.checksum = checksum.Get();
+    memcpy(record.data(), &header.checksum, sizeof(header.checksum));
+    buffer_.insert(buffer_.end(), record.begin(), record.end());
+    return last_lsn_;
+}
+
+void WriteAheadLog::Commit(uint64_t lsn) {
+    Flush(lsn, sync_policy_ == LogSyncPolicy::EVERY_COMMIT);
+}
+
+void WriteAheadLog::Sync() {
+    Flush(GetLastLsn(), true);
+}
+
+void WriteAheadLog::Flush(uint64_t lsn, bool need_sync) {
+    unique_lock lock(mutex_);
+    while (written_lsn_ < lsn || (need_sync && synced_lsn_ < lsn)) {
+        if (is_failed_) {
+            throw runtime_error("Log failed on an earlier write");
+        }
+        if (is_flushing_) {
+            flushed_.wait(lock);
+            continue;
+        }
+        // этот поток пишет всё накопленное, в том числе записи ждущих потоков
+        is_flushing_ = true;
+        vector<char> data;
+        data.swap(buffer_);
+        const uint64_t target_lsn = last_lsn_;
+        lock.unlock();
+        try {
+            WriteAll(descriptor_, data.data(), data.size());
+            if (need_sync) {
+                SyncDescriptor(descriptor_);
+            }
+        } catch (...) {
+            // written_lsn_ и synced_lsn_ не сдвигаются: ждущие потоки тоже
+            // получат исключение, а не подтверждение потерянных записей
+            lock.lock();
+            is_flushing_ = false;
+            is_failed_ = true;
+            flushed_.notify_all();
+            throw;
+        }
+        lock.lock();
+        is_flushing_ = false;
+        written_lsn_ = target_lsn;
+        if (need_sync) {
+            synced_lsn_ = target_lsn;
+        }
+        flushed_.notify_all();
+    }
+}
+
+void WriteAheadLog::SyncPeriodically(chrono::milliseconds sync_interval) {
+    unique_lock lock(mutex_);
+    while (!stop_requested_.wait_for(lock, sync_interval, [this] { return is_stopping_; })) {
+        const uint64_t lsn = last_lsn_;
+        if (is_failed_ || synced_lsn_ >= lsn) {
+            continue;
+        }
+        lock.unlock();
+        try {
+            Flush(lsn, true);
+        } catch (const exception&) {
+            // журнал помечен непригодным; ошибку получат Commit и Sync
+        }
+        lock.lock();
+    }
+}
+
+void WriteAheadLog::Truncate(uint64_t lsn) {
+    Flush(GetLastLsn(), true);
+    // файл переписывается под мьютексом: Append и Commit других потоков
+    // ждут, пока файл не будет записан и сброшен на диск
+    unique_lock lock(mutex_);
+    flushed_.wait(lock, [this] { return !is_flushing_; });
+    if (is_failed_) {
+        throw runtime_error("Log failed on an earlier write");
+    }
+
+    LogHeader header{};
+    vector<char> kept_records;
+    {
+        const MappedFile file(path_);
+        const char* const end = file.data() + file.size();
+        const char* position = ReadHeader(file.data(), file.size(), header.base_lsn);
+        const char* first_kept = nullptr;
+        uint64_t previous_lsn = header.base_lsn;
+        LogRecord record;
+        for (const char* record_start = position; ReadRecord(position, end, previous_lsn, record);
+             record_start = position) {
+            if (record.lsn > lsn && first_kept == nullptr) {
+                first_kept = record_start;
+            }
+            previous_lsn = record.lsn;
+        }
+        if (first_kept != nullptr) {
+            kept_records.assign(first_kept, position);
+        }
+        // нумерация продолжается с lsn и после удаления всех записей
+        header.base_lsn = max(header.base_lsn, lsn);
+    }
+    if (last_lsn_ < lsn) {
+        last_lsn_ = written_lsn_ = synced_lsn_ = lsn;
+    }
+    copy(begin(LOG_MAGIC), end(LOG_MAGIC), header.magic);
+
+    const string temporary_path = path_ + ".tmp";
+    const int descriptor = open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (descriptor < 0) {
+        throw runtime_error("Cannot write log");
+    }
+    try {
+        WriteAll(descriptor, reinterpret_cast<const char*>(&header), sizeof(header));
+        WriteAll(descriptor, kept_records.data(), kept_records.size());
+        SyncDescriptor(descriptor);
+    } catch (...) {
+        close(descriptor);
+        throw;
+    }
+    close(descriptor);
+    if (rename(temporary_path.c_str(), path_.c_str()) != 0) {
+        throw runtime_error("Cannot write log");
+    }
+    // до этого после сбоя питания может вернуться старый файл, а снимок,
+    // ради которого записи удалялись, - пропасть
+    SyncParentDirectory(path_);
+    close(descriptor_);
+    descriptor_ = open(path_.c_str(), O_RDWR | O_APPEND);
+    if (descriptor_ < 0) {
+        throw runtime_error("Cannot open log");
+    }
+}
+
+uint64_t WriteAheadLog::GetLastLsn() const {
+    lock_guard lock(mutex_);
+    return last_lsn_;
+}
+
+const char* WriteAheadLog::ReadHeader(const char* data, size_t size, uint64_t& base_lsn) {
+    LogHeader header;
+    if (size < sizeof(header)) {
+        throw runtime_error("Log is corrupted");
+    }
+    memcpy(&header, data, sizeof(header));
+    if (!equal(begin(LOG_MAGIC), end(LOG_MAGIC), header.magic)
+            && !equal(begin(LOG_MAGIC_V1), end(LOG_MAGIC_V1), header.magic)) {
+        // та же сигнатура с другой версией - журнал новой версии программы
+        throw runtime_error(equal(begin(LOG_MAGIC), end(LOG_MAGIC) - 1, header.magic)
+                            ? "Unsupported log version" : "Log is corrupted");
+    }
+    base_lsn = header.base_lsn;
+    return data + sizeof(header);
+}
+
+bool WriteAheadLog::ReadRecord(const char*& position, const char* end, uint64_t previous_lsn, LogRecord& record) {
+    RecordHeader header;
+    if (static_cast<size_t>(end - position) < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, position, sizeof(header));
+    const size_t record_size = sizeof(header) + PadTo8(header.payload_size);
+    if (record_size > static_cast<size_t>(end - position) || header.lsn <= previous_lsn) {
+        return false;
+    }
+    SnapshotChecksum checksum;
+    checksum.Update(position + sizeof(header.checksum), record_size - sizeof(header.checksum));
+    if (checksum.Get() != header.checksum) {
+        return false;
+    }
+
+    const char* payload = position + sizeof(header);
+    const auto read_value = [&payload](auto& value) {
+        memcpy(&value, payload, sizeof(value));
+        payload += sizeof(value);
+    };
+    record.lsn = header.lsn;
+    record.type = static_cast<LogRecordType>(header.type);
+    record.ratings.clear();
+    record.text = {};
+    if (record.type == LogRecordType::ADD_DOCUMENT || record.type == LogRecordType::UPDATE_DOCUMENT) {
+        uint32_t status, rating_count, text_size;
+        if (header.payload_size < sizeof(int) + 3 * sizeof(uint32_t)) {
+            return false;
+        }
+        read_value(record.document_id);
+        read_value(status);
+        read_value(rating_count);
+        read_value(text_size);
+        if (header.payload_size != sizeof(int) + 3 * sizeof(uint32_t) + rating_count * sizeof(int) + text_size) {
+            return false;
+        }
+        record.status = static_cast<DocumentStatus>(status);
+        record.ratings.resize(rating_count);
+        for (int& rating : record.ratings) {
+            read_value(rating);
+        }
+        record.text = string_view(payload, text_size);
+    } else if (record.type == LogRecordType::REMOVE_DOCUMENT && header.payload_size == sizeof(int)) {
+        read_value(record.document_id);
+    } else if (record.type == LogRecordType::SET_STATUS && header.payload_size == sizeof(int) + sizeof(uint32_t)) {
+        uint32_t status;
+        read_value(record.document_id);
+        read_value(status);
+        record.status = static_cast<DocumentStatus>(status);
+    } else if (record.type == LogRecordType::SET_RATING && header.payload_size >= sizeof(int) + sizeof(uint32_t)) {
+        uint32_t rating_count;
+        read_value(record.document_id);
+        read_value(rating_count);
+        if (header.payload_size != sizeof(int) + sizeof(uint32_t) + rating_count * sizeof(int)) {
+            return false;
+        }
+        record.ratings.resize(rating_count);
+        for (int& rating : record.ratings) {
+            read_value(rating);
+        }
+    } else if (header.type < static_cast<uint32_t>(LogRecordType::ADD_DOCUMENT)
+               || header.type > static_cast<uint32_t>(LogRecordType::SET_RATING)) {
+        // запись целая, но её тип неизвестен: журнал записан новой версией,
+        // отрезать её как оборванный хвост нельзя
+        throw runtime_error("Unknown log record type");
+    } else {
+        return false;
+    }
+    position += record_size;
+    return true;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "document.h"
+#include "snapshot.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Когда изменения журнала попадают на диск
+enum class LogSyncPolicy {
+    // Commit ждёт fsync; одновременные Commit разных потоков
+    // объединяются в один fsync (group commit)
+    EVERY_COMMIT,
+    // Commit передаёт данные ОС, fsync - в фоне раз в sync_interval.
+    // Переживает падение процесса, при отключении питания теряется
+    // не больше интервала
+    PERIODIC,
+    // только передача данных ОС
+    NONE,
+};
+
+// Когда сервер, пишущий в журнал, ждёт подтверждения своих записей
+enum class LogCommitMode {
+    // каждое изменение ждёт Commit своей записи, прежде чем менять индекс
+    EACH_CHANGE,
+    // изменение только добавляет запись в буфер журнала и сразу меняется
+    // в индексе; подтверждает вызывающий через WriteAheadLog::Commit
+    DEFERRED,
+};
+
+enum class LogRecordType : uint32_t {
+    ADD_DOCUMENT = 1,
+    REMOVE_DOCUMENT = 2,
+    // новые текст, статус и оценки документа, данные как у ADD_DOCUMENT
+    UPDATE_DOCUMENT = 3,
+    SET_STATUS = 4,
+    SET_RATING = 5,
+};
+
+// Запись журнала; text указывает в память журнала и действителен
+// только внутри обработчика ForEachRecord
+struct LogRecord {
+    uint64_t lsn = 0;
+    LogRecordType type = LogRecordType::ADD_DOCUMENT;
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string_view text;
+};
+
+// Журнал упреждающей записи: файл из заголовка (сигнатура с версией
+// формата и номер, с которого продолжается нумерация после усечения) и
+// записей с контрольными суммами. Номера записей (LSN) строго растут.
+// Оборванная при падении запись в конце файла отбрасывается при открытии;
+// журнал другой версии и целая запись неизвестного типа - исключение
+class WriteAheadLog {
+public:
+    explicit WriteAheadLog(const std::string& path, LogSyncPolicy sync_policy = LogSyncPolicy::EVERY_COMMIT,
+                           std::chrono::milliseconds sync_interval = std::chrono::milliseconds(10));
+    ~WriteAheadLog();
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Запись попадает в буфер и получает LSN; на диск - после Commit
+    uint64_t AppendAddDocument(int document_id, std::string_view document, DocumentStatus status,
+                               const std::vector<int>& ratings);
+    uint64_t AppendRemoveDocument(int document_id);
+    uint64_t AppendUpdateDocument(int document_id, std::string_view document, DocumentStatus status,
+                                  const std::vector<int>& ratings);
+    uint64_t AppendSetStatus(int document_id, DocumentStatus status);
+    uint64_t AppendSetRating(int document_id, const std::vector<int>& ratings);
+
+    // Ждёт, пока записи до lsn включительно сохранятся по политике журнала.
+    // Данные пишет один поток за всех ожидающих, остальные ждут его.
+    // После ошибки записи журнал непригоден: Append и Commit бросают
+    // исключение, записи без подтверждения остаются только в памяти
+    void Commit(uint64_t lsn);
+    // Сохраняет всё записанное с fsync независимо от политики
+    void Sync();
+
+    // Удаляет записи с LSN не больше lsn, например вошедшие в снимок.
+    // Файл переписывается и атомарно заменяется
+    void Truncate(uint64_t lsn);
+
+    // func(const LogRecord&) для записей с LSN больше after_lsn по порядку
+    template <typename Func>
+    void ForEachRecord(uint64_t after_lsn, Func func);
+
+    uint64_t GetLastLsn() const;
+
+private:
+    std::string path_;
+    LogSyncPolicy sync_policy_;
+    int descriptor_ = -1;
+
+    mutable std::mutex mutex_;
+    std::condition_variable flushed_;
+    // записи, ещё не переданные ОС
+    std::vector<char> buffer_;
+    uint64_t last_lsn_ = 0;
+    uint64_t written_lsn_ = 0;
+    uint64_t synced_lsn_ = 0;
+    // данные пишет один поток, остальные ждут flushed_
+    bool is_flushing_ = false;
+    // Запись или fsync не удались: в файле может остаться оборванная запись,
+    // а после ошибки fsync неизвестно, что дошло до диска. Дописывать за
+    // ней нельзя - при открытии всё после оборванной записи отрезается,
+    // поэтому журнал дальше только бросает исключения
+    bool is_failed_ = false;
+
+    std::condition_variable stop_requested_;
+    bool is_stopping_ = false;
+    std::thread sync_thread_;
+
+    void Flush(uint64_t lsn, bool need_sync);
+    uint64_t AppendRecord(LogRecordType type, const std::vector<char>& payload);
+    uint64_t AppendDocument(LogRecordType type, int document_id, std::string_view document, DocumentStatus status,
+                            const std::vector<int>& ratings);
+    void Open();
+    void SyncPeriodically(std::chrono::milliseconds sync_interval);
+
+    // Читает запись из [position, end); false в конце журнала или на
+    // оборванной записи. position сдвигается за прочитанную запись
+    static bool ReadRecord(const char*& position, const char* end, uint64_t previous_lsn, LogRecord& record);
+    // Заголовок файла журнала; возвращает начало записей
+    static const char* ReadHeader(const char* data, size_t size, uint64_t& base_lsn);
+};
+
+template <typename Func>
+void WriteAheadLog::ForEachRecord(uint64_t after_lsn, Func func) {
+    Flush(GetLastLsn(), false);
+    const MappedFile file(path_);
+    uint64_t base_lsn;
+    const char* position = ReadHeader(file.data(), file.size(), base_lsn);
+    LogRecord record;
+    uint64_t previous_lsn = base_lsn;
+    while (ReadRecord(position, file.data() + file.size(), previous_lsn, record)) {
+        previous_lsn = record.lsn;
+        if (record.lsn > after_lsn) {
+            func(static_cast<const LogRecord&>(record));
+        }
+    }
+}